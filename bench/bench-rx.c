@@ -0,0 +1,132 @@
+/*
+ *  (C) Copyright 2021 Kontron Europe GmbH, Saarbruecken
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#define main old_main
+#include "../rx.c"
+#undef main
+
+#include "bench.h"
+
+static unsigned char frame[2048];
+static union {
+    char buf[CMSG_SPACE(sizeof(struct timespec) * 3)];
+    struct cmsghdr align;
+} control;
+static struct iovec iov;
+static struct msghdr msg;
+static struct timespec prog_ts;
+static struct timespec rx_tss[MAX_TS_RX];
+static struct ether_testpacket tp_host;
+static struct ether_testpacket *tp = &tp_host;
+static struct result seq_result;
+
+/* a test packet with all TX timestamps and SO_TIMESTAMPING RX timestamps */
+static void setup_msg(void)
+{
+    struct timespec scm_ts[3];
+    struct cmsghdr *cmsg;
+    struct timespec ts;
+    int i;
+
+    memset(frame, 0, sizeof(frame));
+    memset(tp, 0, sizeof(*tp));
+    tp->hdr.ether_type = htons(TP_ETHER_TYPE);
+    tp->version = 1;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    for (i = 0; i < TS_MAX_NUM; i++) {
+        memcpy(&tp->timestamps[i], &ts, sizeof(ts));
+    }
+    prog_ts = ts;
+
+    iov.iov_base = frame;
+    iov.iov_len = tp_encode(tp, TS_MAX_NUM, frame, sizeof(frame));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    scm_ts[0] = ts;
+    scm_ts[1] = ts;
+    scm_ts[2] = ts;
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SO_TIMESTAMPING;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(scm_ts));
+    memcpy(CMSG_DATA(cmsg), scm_ts, sizeof(scm_ts));
+}
+
+static void bench_handle_msg(void)
+{
+    struct ether_testpacket_v1 *wire = (void *)frame;
+
+    wire->seq++;
+    handle_msg(&msg, &prog_ts);
+}
+
+static void setup_json_test_packet(void)
+{
+    int i;
+
+    setup_msg();
+    for (i = 0; i < MAX_TS_RX; i++) {
+        rx_tss[i] = prog_ts;
+    }
+}
+
+static void bench_json_test_packet(void)
+{
+    json_t *j;
+
+    j = json_test_packet(tp, tp, rx_tss);
+    dump_json_stdout(j);
+    json_decref(j);
+}
+
+static void bench_timespec_to_iso_string(void)
+{
+    g_free(timespec_to_iso_string(&prog_ts));
+}
+
+static void setup_check_sequence_num(void)
+{
+    seq_result.tp = g_new0(struct ether_testpacket, 1);
+    seq_result.last_tp = g_new0(struct ether_testpacket, 1);
+}
+
+static void bench_check_sequence_num(void)
+{
+    seq_result.last_tp->seq = seq_result.tp->seq;
+    seq_result.tp->seq++;
+    check_sequence_num(&seq_result);
+}
+
+static void bench_get_hw_timestamps(void)
+{
+    struct timespec sw, hw;
+
+    get_hw_timestamps(&msg, &sw, &hw);
+}
+
+static struct bench benches[] = {
+    { "rx/handle_msg", setup_msg, bench_handle_msg },
+    { "rx/json_test_packet", setup_json_test_packet,
+        bench_json_test_packet },
+    { "rx/timespec_to_iso_string", setup_msg,
+        bench_timespec_to_iso_string },
+    { "rx/check_sequence_num", setup_check_sequence_num,
+        bench_check_sequence_num },
+    { "rx/get_hw_timestamps", setup_msg, bench_get_hw_timestamps },
+    { NULL, NULL, NULL }
+};
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, benches);
+}
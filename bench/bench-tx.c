@@ -0,0 +1,41 @@
+/*
+ *  (C) Copyright 2021 Kontron Europe GmbH, Saarbruecken
+ */
+/* tx.c defines _GNU_SOURCE and has to be included first */
+#define main old_main
+#include "../tx.c"
+#undef main
+
+#include "bench.h"
+
+static struct stats_stream *stream;
+
+static void bench_tp_set_timestamp(void)
+{
+    tp_set_timestamp(tp, TS_PROG_SEND, NULL);
+}
+
+static void setup_update_shm_stats(void)
+{
+    stream = g_new0(struct stats_stream, 1);
+    histogram_init(&stream->latency);
+    tp_set_timestamp(tp, TS_T0, NULL);
+    tp_set_timestamp(tp, TS_WAKEUP, NULL);
+}
+
+static void bench_update_shm_stats(void)
+{
+    update_shm_stats(stream, tp, FALSE);
+}
+
+static struct bench benches[] = {
+    { "tx/tp_set_timestamp", NULL, bench_tp_set_timestamp },
+    { "tx/update_shm_stats", setup_update_shm_stats,
+        bench_update_shm_stats },
+    { NULL, NULL, NULL }
+};
+
+int main(int argc, char **argv)
+{
+    return bench_main(argc, argv, benches);
+}
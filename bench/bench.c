@@ -0,0 +1,277 @@
+/*
+ *  (C) Copyright 2021 Kontron Europe GmbH, Saarbruecken
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include <jansson.h>
+
+#include "bench.h"
+
+#define BENCH_RUNS 3
+
+static gchar *o_baseline = NULL;
+static gchar *o_filter = NULL;
+static gint o_min_time_ms = 200;
+static gint o_threshold_pct = 10;
+
+static FILE *out;
+static guint64 allocs;
+
+/*
+ * Count the allocations of the benchmarked code, including the ones of glib
+ * and jansson. This relies on the glibc internal allocator entry points.
+ */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    allocs++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    allocs++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    allocs++;
+    return __libc_realloc(ptr, size);
+}
+
+static gint64 now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (gint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static gint64 run_iterations(struct bench *b, guint64 iterations,
+        guint64 *n_allocs)
+{
+    guint64 i;
+    guint64 a;
+    gint64 start;
+
+    a = allocs;
+    start = now_ns();
+    for (i = 0; i < iterations; i++) {
+        b->run();
+    }
+    *n_allocs = allocs - a;
+
+    return now_ns() - start;
+}
+
+/* double the iterations until a run takes long enough to be measured */
+static guint64 calibrate(struct bench *b)
+{
+    guint64 iterations = 1;
+    guint64 n_allocs;
+    gint64 elapsed;
+    gint64 min_time = (gint64)o_min_time_ms * 1000000;
+
+    for (;;) {
+        elapsed = run_iterations(b, iterations, &n_allocs);
+        if (elapsed >= min_time / 10 || iterations >= (1ULL << 40)) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    if (elapsed <= 0) {
+        return iterations;
+    }
+
+    return MAX(iterations, (guint64)((gdouble)iterations * min_time / elapsed));
+}
+
+static json_t *baseline_find(json_t *baseline, const gchar *name)
+{
+    json_t *j;
+    size_t i;
+
+    json_array_foreach(baseline, i, j) {
+        json_t *object = json_object_get(j, "object");
+        if (!g_strcmp0(json_string_value(json_object_get(object, "name")),
+                    name)) {
+            return object;
+        }
+    }
+
+    return NULL;
+}
+
+/* compare with the baseline and return TRUE on a regression */
+static gboolean compare_baseline(json_t *object, json_t *baseline)
+{
+    gdouble ns = json_real_value(json_object_get(object, "ns-per-op"));
+    gdouble a = json_real_value(json_object_get(object, "allocs-per-op"));
+    gdouble base_ns = json_number_value(json_object_get(baseline,
+                "ns-per-op"));
+    gdouble base_a = json_number_value(json_object_get(baseline,
+                "allocs-per-op"));
+    gdouble change = 0;
+    gboolean regression;
+
+    if (base_ns > 0) {
+        change = (ns - base_ns) * 100.0 / base_ns;
+    }
+    regression = change > o_threshold_pct || a > base_a + 0.01;
+
+    json_object_set_new(object, "baseline-ns-per-op", json_real(base_ns));
+    json_object_set_new(object, "baseline-allocs-per-op", json_real(base_a));
+    json_object_set_new(object, "change-pct", json_real(change));
+    json_object_set_new(object, "regression", json_boolean(regression));
+
+    return regression;
+}
+
+static json_t *bench_run(struct bench *b)
+{
+    guint64 iterations;
+    guint64 n_allocs = 0;
+    gint64 best = G_MAXINT64;
+    gdouble ns_per_op;
+    int i;
+
+    if (b->setup) {
+        b->setup();
+    }
+
+    iterations = calibrate(b);
+
+    /* the fastest run is the least disturbed one */
+    for (i = 0; i < BENCH_RUNS; i++) {
+        best = MIN(best, run_iterations(b, iterations, &n_allocs));
+    }
+
+    ns_per_op = (gdouble)best / iterations;
+
+    return json_pack("{sss{sssIsfsfsf}}",
+            "type", "bench",
+            "object",
+            "name", b->name,
+            "iterations", (json_int_t)iterations,
+            "ns-per-op", ns_per_op,
+            "allocs-per-op", (gdouble)n_allocs / iterations,
+            "packets-per-sec", ns_per_op > 0 ? 1e9 / ns_per_op : 0.0);
+}
+
+/* the baseline is the output of a previous run, one record per line */
+static json_t *load_baseline(const gchar *path)
+{
+    json_t *baseline = json_array();
+    gchar *contents;
+    gchar **lines;
+    int i;
+
+    if (!g_file_get_contents(path, &contents, NULL, NULL)) {
+        fprintf(stderr, "cannot read baseline %s\n", path);
+        json_decref(baseline);
+        return NULL;
+    }
+
+    lines = g_strsplit(contents, "\n", -1);
+    for (i = 0; lines[i]; i++) {
+        json_t *j = json_loads(lines[i], 0, NULL);
+        if (j) {
+            json_array_append_new(baseline, j);
+        }
+    }
+
+    g_strfreev(lines);
+    g_free(contents);
+
+    return baseline;
+}
+
+static GOptionEntry entries[] = {
+    { "baseline",  'b', 0, G_OPTION_ARG_STRING,
+            &o_baseline, "Compare with the results in FILE", "FILE" },
+    { "threshold", 't', 0, G_OPTION_ARG_INT,
+            &o_threshold_pct, "Slowdown reported as regression"
+            " (default is 10%)", "PCT" },
+    { "min-time",  'm', 0, G_OPTION_ARG_INT,
+            &o_min_time_ms, "Minimum time of a run (default is 200 msec)",
+            "MSEC" },
+    { "filter",    'f', 0, G_OPTION_ARG_STRING,
+            &o_filter, "Run only benchmarks containing NAME", "NAME" },
+    { NULL, 0, 0, 0, NULL, NULL, NULL }
+};
+
+int bench_main(int argc, char **argv, struct bench *benches)
+{
+    GOptionContext *context;
+    GError *error = NULL;
+    json_t *baseline = NULL;
+    gboolean regression = FALSE;
+    struct bench *b;
+    int fd;
+
+    context = g_option_context_new("- run benchmarks");
+    g_option_context_add_main_entries(context, entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_print("option parsing failed: %s\n", error->message);
+        exit(1);
+    }
+    g_option_context_free(context);
+
+    if (o_baseline) {
+        baseline = load_baseline(o_baseline);
+        if (baseline == NULL) {
+            return 1;
+        }
+    }
+
+    /* the results are written to the original stdout */
+    out = fdopen(dup(STDOUT_FILENO), "w");
+    fd = open("/dev/null", O_WRONLY);
+    if (out == NULL || fd < 0) {
+        perror("bench output");
+        return 1;
+    }
+    dup2(fd, STDOUT_FILENO);
+    close(fd);
+
+    for (b = benches; b->name; b++) {
+        json_t *j;
+        char *s;
+
+        if (o_filter && !strstr(b->name, o_filter)) {
+            continue;
+        }
+
+        j = bench_run(b);
+        if (baseline) {
+            json_t *base = baseline_find(baseline, b->name);
+            if (base) {
+                regression |= compare_baseline(json_object_get(j, "object"),
+                        base);
+            }
+        }
+
+        s = json_dumps(j, JSON_COMPACT);
+        fprintf(out, "%s\n", s);
+        fflush(out);
+        free(s);
+        json_decref(j);
+    }
+
+    json_decref(baseline);
+    fclose(out);
+
+    return regression ? 1 : 0;
+}
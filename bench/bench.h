@@ -0,0 +1,24 @@
+/*
+ *  (C) Copyright 2021 Kontron Europe GmbH, Saarbruecken
+ */
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+/*
+ * A benchmark runs one operation per call, e.g. the handling of a single
+ * packet. The optional setup is called once before the measurement.
+ */
+struct bench {
+    const gchar *name;
+    void (*setup)(void);
+    void (*run)(void);
+};
+
+/*
+ * Run all benchmarks of the NULL terminated list and print one JSON record
+ * per benchmark to stdout. The stdout of the benchmarked code is discarded.
+ * Returns non-zero if a regression against the baseline was found.
+ */
+int bench_main(int argc, char **argv, struct bench *benches);
+
+#endif /* __BENCH_H__ */
@@ -0,0 +1,31 @@
+BENCH_LIST := rx tx
+
+BENCH_BINARIES = $(addprefix $(o)bench/bench-,$(BENCH_LIST))
+CLEAN_TARGETS += clean-bench
+
+# compare with a previous run: make bench BENCH_BASELINE=baseline.json
+bench_cmd = @$< $(if $(BENCH_BASELINE),--baseline $(BENCH_BASELINE)) \
+		$(if $(BENCH_THRESHOLD),--threshold $(BENCH_THRESHOLD))
+
+$(o)bench/%.o: bench/%.c
+	$(call compile_tgt,bench)
+
+$(o)bench/bench-rx: $(o)bench/bench-rx.o $(o)bench/bench.o $(o)timer.o \
+		$(o)json.o $(o)stream.o $(o)histogram.o $(o)packet.o $(o)pcapng.o \
+		$(o)recorder.o $(o)ftrace.o $(o)skew.o $(o)stats.o
+	$(call link_tgt,bench)
+
+$(o)bench/bench-tx: $(o)bench/bench-tx.o $(o)bench/bench.o $(o)timer.o \
+		$(o)histogram.o $(o)packet.o $(o)ftrace.o $(o)stats.o
+	$(call link_tgt,bench)
+
+bench-%: $(o)bench/bench-%
+	$(call bench_cmd)
+
+.PHONY: bench
+bench: $(addprefix bench-,$(BENCH_LIST))
+
+
+clean-bench:
+	rm -f $(BENCH_BINARIES)
+	rm -f $(o)bench/*.o
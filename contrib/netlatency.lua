@@ -31,9 +31,15 @@ fds.stream_id = ProtoField.int8("netlatency.stream_id", "Stream ID", base.DEC)
 fds.sequence_number = ProtoField.int32("netlatency.sequence_number", "Sequence Number", base.DEC)
 fds.interval = ProtoField.int16("netlatency.interval", "Interval", base.DEC)
 fds.offset = ProtoField.int16("netlatency.offset", "Time offset", base.DEC)
+fds.sequence_number64 = ProtoField.uint64("netlatency.sequence_number", "Sequence Number", base.DEC)
+fds.interval_ns = ProtoField.uint32("netlatency.interval_ns", "Interval (ns)", base.DEC)
+fds.offset_ns = ProtoField.int32("netlatency.offset_ns", "Time offset (ns)", base.DEC)
 fds.flags = ProtoField.int32("netlatency.flags", "Flags", base.DEC)
 fds.flags_eos = ProtoField.bool("netlatency.flags.eos", "End Of Stream", 32, nil, 0x1)
 fds.flags_small_mode = ProtoField.bool("netlatency.flags.sm", "Small Mode", 32, nil, 0x2)
+fds.flags_late = ProtoField.bool("netlatency.flags.late", "Late", 32, nil, 0x8)
+fds.flags_overrun_marker = ProtoField.bool("netlatency.flags.om", "Overrun Marker", 32, nil, 0x10)
+fds.flags_overruns = ProtoField.uint32("netlatency.flags.overruns", "Missed Intervals", base.DEC, nil, 0xffff0000)
 
 function netlatency_protocol.dissector(buffer, pinfo, tree)
 	length = buffer:len()
@@ -42,15 +48,27 @@ function netlatency_protocol.dissector(buffer, pinfo, tree)
 	pinfo.cols.protocol = netlatency_protocol.name
 
 	local subtree = tree:add(netlatency_protocol, buffer(), "Netlatency Protocol Data")
+	local version = buffer(0,1):le_uint()
+	local flags_buf
 	subtree:add_le(fds.version,         buffer(0,1))
 	subtree:add_le(fds.stream_id,       buffer(1,1))
-	subtree:add_le(fds.sequence_number, buffer(2,4))
-	subtree:add_le(fds.interval,        buffer(6,2))
-	subtree:add_le(fds.offset,          buffer(8,2))
-	local flags_buf = buffer(10,4)
-	local flagstree = subtree:add(fds.flags, flags_buf)
-	flagstree:add(fds.flags_eos, flags_buf)
-	flagstree:add(fds.flags_small_mode, flags_buf)
+	if version == 2 then
+		flags_buf = buffer(4,4)
+		subtree:add_le(fds.sequence_number64, buffer(8,8))
+		subtree:add_le(fds.interval_ns,       buffer(16,4))
+		subtree:add_le(fds.offset_ns,         buffer(20,4))
+	else
+		flags_buf = buffer(10,4)
+		subtree:add_le(fds.sequence_number, buffer(2,4))
+		subtree:add_le(fds.interval,        buffer(6,2))
+		subtree:add_le(fds.offset,          buffer(8,2))
+	end
+	local flagstree = subtree:add_le(fds.flags, flags_buf)
+	flagstree:add_le(fds.flags_eos, flags_buf)
+	flagstree:add_le(fds.flags_small_mode, flags_buf)
+	flagstree:add_le(fds.flags_late, flags_buf)
+	flagstree:add_le(fds.flags_overrun_marker, flags_buf)
+	flagstree:add_le(fds.flags_overruns, flags_buf)
 end
 
 local eth_type = DissectorTable.get("ethertype")
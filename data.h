@@ -30,6 +30,8 @@
 #include <net/ethernet.h>
 #include <netinet/ether.h>
 
+#include "histogram.h"
+
 #define TP_ETHER_TYPE 0x0808
 
 enum {
@@ -45,7 +47,26 @@ enum {
 	TS_MAX_SHORT = 1,
 };
 
+/*
+ * A test packet in host representation. It is converted from and to one of
+ * the wire formats below by packet.c.
+ */
 struct ether_testpacket {
+	struct ether_header hdr;
+	guint8 version;
+	guint8 stream_id;
+	guint64 seq;
+	guint32 interval_usec;
+	gint32 offset_usec;
+	guint32 flags;
+	struct timespec timestamps[TS_MAX_NUM];
+};
+
+/*
+ * Version 1 wire format, in the byte order and struct timespec layout of the
+ * sender. The interval is truncated to 16 bits.
+ */
+struct ether_testpacket_v1 {
 	struct ether_header hdr;
 	guint8 version;
 	guint8 stream_id;
@@ -56,6 +77,33 @@ struct ether_testpacket {
 	struct timespec timestamps[TS_MAX_NUM];
 } __attribute__((__packed__));
 
+/*
+ * Version 2 wire format, all fields are little-endian. Timestamps are
+ * nanoseconds since the epoch, 0 if not available.
+ */
+struct ether_testpacket_v2 {
+	struct ether_header hdr;
+	guint8 version;
+	guint8 stream_id;
+	guint16 reserved;
+	guint32 flags;
+	guint64 seq;
+	guint32 interval_ns;
+	gint32 offset_ns;
+	gint64 timestamps[TS_MAX_NUM];
+} __attribute__((__packed__));
+
+#define TP_VERSION_1 1
+#define TP_VERSION_2 2
+
+enum {
+    TS_KERNEL_HW_RX,
+    TS_KERNEL_SW_RX,
+    TS_PROG_RECV,
+
+    MAX_TS_RX
+};
+
 struct result {
     struct ether_testpacket *tp;
     struct ether_testpacket *last_tp;
@@ -65,20 +113,127 @@ struct result {
 
     gint dropped;
     gboolean seq_error;
+
+    /* dropped packets caused by a sender overrun, a receive buffer overflow
+     * or the network */
+    gint sender_overrun;
+    gint local_overflow;
+    gint network_loss;
+
+    /* follow-up mode: test packets waiting for their follow-up frame */
+    struct pending_entry *pending;
+};
+
+/*
+ * A test packet and its follow-up frame are joined by sequence number in a
+ * fixed window per stream. Entries which are not completed within the
+ * follow-up timeout are flushed without kernel TX timestamps.
+ */
+#define RX_PENDING_WINDOW 64
+
+struct pending_entry {
+    guint64 seq;
+    gboolean have_tp;
+    gboolean have_fu;
+    gint64 expires;
+
+    struct ether_testpacket tp;
+    struct ether_testpacket fu;
+    struct timespec rx_tss[MAX_TS_RX];
 };
 
+/*
+ * Latency stages between two adjacent timestamps of a test packet, from the
+ * interval start on the sender to the receiving program. A stage is invalid
+ * if one of its timestamps is missing.
+ */
 enum {
-    TS_KERNEL_HW_RX,
-    TS_KERNEL_SW_RX,
-    TS_PROG_RECV,
+    STAGE_WAKEUP_T0 = 0,
+    STAGE_PROGRAM_WAKEUP,
+    STAGE_NETSCHED_PROGRAM,
+    STAGE_DRIVER_NETSCHED,
+    STAGE_WIRE,
+    STAGE_RX_SW_HW,
+    STAGE_RX_PROGRAM_SW,
 
-    MAX_TS_RX
+    MAX_STAGE
+};
+
+struct decomposition {
+    guint8 stream_id;
+    guint64 seq;
+    gint64 delta[MAX_STAGE];
+    gboolean valid[MAX_STAGE];
 };
 
-#define TP_HDR_LEN offsetof(struct ether_testpacket, timestamps)
+/* cumulated PACKET_STATISTICS of the capture socket */
+struct socket_stats {
+    guint64 packets;
+    guint64 drops;
+    guint64 freeze_q_cnt;
+};
+
+/*
+ * Processing stages of nl-rx itself, from the return of the receive call
+ * to the analysis of the packet, the formatting and the writing of its
+ * records.
+ */
+enum {
+    SELF_ANALYSIS = 0,
+    SELF_FORMAT,
+    SELF_WRITE,
+    SELF_TOTAL,
+
+    MAX_SELF_STAGE
+};
+
+struct self_stats {
+    gint64 interval_ns;
+    guint64 packets;
+    gint64 utime_usec;
+    gint64 stime_usec;
+    glong max_rss_kb;
+    struct histogram stages[MAX_SELF_STAGE];
+};
+
+/* counters of a stream between two rx-summary records */
+struct rx_summary {
+    gint64 interval_ns;
+    guint64 packets;
+    guint64 dropped;
+    guint64 seq_errors;
+    guint64 events;
+    guint64 suppressed;
+    struct histogram latency;
+};
+
+#define TP_HDR_LEN offsetof(struct ether_testpacket_v1, timestamps)
 #define TP_LEN(x) (TP_HDR_LEN + sizeof(struct timespec) * (x))
+#define TP_V2_HDR_LEN offsetof(struct ether_testpacket_v2, timestamps)
+#define TP_V2_LEN(x) (TP_V2_HDR_LEN + sizeof(gint64) * (x))
 
 #define TP_FLAG_END_OF_STREAM  (1 << 0)
 #define TP_FLAG_SMALL_MODE     (1 << 1)
+/* follow-up frames carry the kernel TX timestamps of the test packet with
+ * the same sequence number in the TS_LAST_KERNEL_* slots */
+#define TP_FLAG_FOLLOW_UP      (1 << 2)
+/* test packet sent late for a missed interval, see nl-tx --overrun late */
+#define TP_FLAG_LATE           (1 << 3)
+/* marker frame of the sender for missed intervals, not a test packet */
+#define TP_FLAG_OVERRUN_MARKER (1 << 4)
+/* test packet sent back by nl-rx --reflect, see tp_reflect() */
+#define TP_FLAG_REFLECTED      (1 << 5)
+
+/* reflected test packets carry the receive and send time of the reflector
+ * in place of the kernel TX timestamps of the last packet, which the sender
+ * knows itself */
+#define TS_REFLECT_RX TS_LAST_KERNEL_SCHED
+#define TS_REFLECT_TX TS_LAST_KERNEL_SW_TX
+
+/* the upper 16 bits of the flags count the intervals the sender has missed
+ * right before this packet without sending, saturated at TP_OVERRUN_MAX */
+#define TP_OVERRUN_SHIFT 16
+#define TP_OVERRUN_MAX 0xffff
+#define TP_OVERRUNS(flags) ((flags) >> TP_OVERRUN_SHIFT)
 
 #endif /* #ifndef __DATA_H__ */
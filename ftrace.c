@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2018, Kontron Europe GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "ftrace.h"
+
+struct ftrace {
+    int marker_fd;
+    int on_fd;
+    gboolean stopped;
+};
+
+static const char *tracefs_paths[] = {
+    "/sys/kernel/tracing",
+    "/sys/kernel/debug/tracing",
+    NULL
+};
+
+static int open_tracefs_file(const gchar *dir, const char *name)
+{
+    gchar *path = g_strdup_printf("%s/%s", dir, name);
+    int fd;
+
+    fd = open(path, O_WRONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+    }
+    g_free(path);
+
+    return fd;
+}
+
+struct ftrace *ftrace_open(const gchar *path)
+{
+    struct ftrace *t;
+    int i;
+
+    if (path == NULL) {
+        for (i = 0; tracefs_paths[i] != NULL; i++) {
+            gchar *marker = g_strdup_printf("%s/trace_marker",
+                    tracefs_paths[i]);
+            gboolean found = access(marker, F_OK) == 0;
+
+            g_free(marker);
+            if (found) {
+                path = tracefs_paths[i];
+                break;
+            }
+        }
+        if (path == NULL) {
+            fprintf(stderr, "No tracefs found, is it mounted?\n");
+            return NULL;
+        }
+    }
+
+    t = g_new0(struct ftrace, 1);
+    t->marker_fd = open_tracefs_file(path, "trace_marker");
+    t->on_fd = open_tracefs_file(path, "tracing_on");
+    if (t->marker_fd < 0 || t->on_fd < 0) {
+        ftrace_close(t);
+        return NULL;
+    }
+
+    return t;
+}
+
+static void ftrace_vmark(struct ftrace *t, const char *fmt, va_list ap)
+{
+    char buf[FTRACE_MARKER_LEN];
+    int len;
+
+    len = vsnprintf(buf, sizeof(buf), fmt, ap);
+    if (len < 0) {
+        return;
+    }
+    if (write(t->marker_fd, buf, MIN(len, (int)sizeof(buf) - 1)) < 0) {
+        /* the marker is best effort */
+    }
+}
+
+void ftrace_mark(struct ftrace *t, const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    ftrace_vmark(t, fmt, ap);
+    va_end(ap);
+}
+
+gboolean ftrace_break(struct ftrace *t, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (t->stopped) {
+        return FALSE;
+    }
+
+    va_start(ap, fmt);
+    ftrace_vmark(t, fmt, ap);
+    va_end(ap);
+
+    if (write(t->on_fd, "0", 1) != 1) {
+        perror("write tracing_on");
+    }
+    t->stopped = TRUE;
+
+    return TRUE;
+}
+
+void ftrace_close(struct ftrace *t)
+{
+    if (t == NULL) {
+        return;
+    }
+
+    if (t->marker_fd >= 0) {
+        close(t->marker_fd);
+    }
+    if (t->on_fd >= 0) {
+        close(t->on_fd);
+    }
+    g_free(t);
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2018, Kontron Europe GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __FTRACE_H__
+#define __FTRACE_H__
+
+#define FTRACE_MARKER_LEN 256
+
+struct ftrace;
+
+/*
+ * Open the trace_marker and tracing_on files of the tracefs mounted at path,
+ * or at /sys/kernel/tracing or /sys/kernel/debug/tracing if path is NULL.
+ * The files are opened once, so a marker costs a single write().
+ */
+struct ftrace *ftrace_open(const gchar *path);
+
+/* write a marker to the trace ring buffer, errors are ignored */
+void ftrace_mark(struct ftrace *t, const char *fmt, ...);
+
+/*
+ * Write the marker and stop tracing, like cyclictest --breaktrace. The
+ * ring buffer keeps the activity up to this point. Only the first call
+ * stops tracing, returns TRUE if it did.
+ */
+gboolean ftrace_break(struct ftrace *t, const char *fmt, ...);
+
+void ftrace_close(struct ftrace *t);
+
+#endif /* __FTRACE_H__ */
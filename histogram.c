@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2018, Kontron Europe GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "histogram.h"
+
+void histogram_init(struct histogram *h)
+{
+    memset(h, 0, sizeof(*h));
+    h->min = G_MAXINT64;
+    h->max = G_MININT64;
+}
+
+guint histogram_bucket(gint64 value)
+{
+    guint msb;
+
+    if (value < HIST_SUB_BUCKETS) {
+        return value;
+    }
+
+    msb = 63 - __builtin_clzll(value);
+    if (msb >= HIST_MAX_BITS) {
+        return HIST_NUM_BUCKETS - 1;
+    }
+
+    return (msb - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS
+        + ((value >> (msb - HIST_SUB_BITS)) & (HIST_SUB_BUCKETS - 1));
+}
+
+gint64 histogram_bucket_lower(guint bucket)
+{
+    guint group = bucket / HIST_SUB_BUCKETS;
+    guint sub = bucket % HIST_SUB_BUCKETS;
+
+    if (group == 0) {
+        return sub;
+    }
+
+    return (gint64)(HIST_SUB_BUCKETS + sub) << (group - 1);
+}
+
+gint64 histogram_bucket_upper(guint bucket)
+{
+    guint group = bucket / HIST_SUB_BUCKETS;
+
+    if (group == 0) {
+        return bucket;
+    }
+
+    return histogram_bucket_lower(bucket) + ((gint64)1 << (group - 1)) - 1;
+}
+
+void histogram_add(struct histogram *h, gint64 value)
+{
+    h->count++;
+    h->sum += value;
+    if (value < h->min) {
+        h->min = value;
+    }
+    if (value > h->max) {
+        h->max = value;
+    }
+
+    if (value < 0) {
+        h->underflow++;
+    } else {
+        h->buckets[histogram_bucket(value)]++;
+    }
+}
+
+void histogram_merge(struct histogram *dst, const struct histogram *src)
+{
+    guint i;
+
+    dst->count += src->count;
+    dst->underflow += src->underflow;
+    dst->sum += src->sum;
+    dst->min = MIN(dst->min, src->min);
+    dst->max = MAX(dst->max, src->max);
+
+    for (i = 0; i < HIST_NUM_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+}
+
+/*
+ * Returns the upper bound of the bucket containing the given percentile,
+ * limited to the observed minimum and maximum.
+ */
+gint64 histogram_percentile(const struct histogram *h, gdouble percentile)
+{
+    guint64 rank;
+    guint64 sum;
+    guint i;
+
+    if (h->count == 0) {
+        return 0;
+    }
+
+    rank = (guint64)ceil(percentile / 100.0 * h->count);
+    rank = CLAMP(rank, 1, h->count);
+
+    sum = h->underflow;
+    if (sum >= rank) {
+        return h->min;
+    }
+
+    for (i = 0; i < HIST_NUM_BUCKETS; i++) {
+        sum += h->buckets[i];
+        if (sum >= rank) {
+            return CLAMP(histogram_bucket_upper(i), h->min, h->max);
+        }
+    }
+
+    return h->max;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2018, Kontron Europe GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __HISTOGRAM_H__
+#define __HISTOGRAM_H__
+
+/*
+ * Log-linear histogram for non-negative nanosecond values. Each power of two
+ * is divided into 2^HIST_SUB_BITS buckets which gives a relative error of
+ * less than 1/2^HIST_SUB_BITS. Values up to 2^HIST_MAX_BITS ns are resolved,
+ * larger ones end up in the last bucket and negative ones are counted as
+ * underflow.
+ *
+ * The structure has a fixed size and contains no pointers, so it can be
+ * placed in shared memory.
+ */
+#define HIST_SUB_BITS 4
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS 40
+#define HIST_NUM_BUCKETS ((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
+
+struct histogram {
+    guint64 count;
+    guint64 underflow;
+    gint64 min;
+    gint64 max;
+    gint64 sum;
+    guint64 buckets[HIST_NUM_BUCKETS];
+};
+
+void histogram_init(struct histogram *h);
+
+void histogram_add(struct histogram *h, gint64 value);
+
+void histogram_merge(struct histogram *dst, const struct histogram *src);
+
+guint histogram_bucket(gint64 value);
+
+gint64 histogram_bucket_lower(guint bucket);
+
+gint64 histogram_bucket_upper(guint bucket);
+
+gint64 histogram_percentile(const struct histogram *h, gdouble percentile);
+
+#endif /* __HISTOGRAM_H__ */
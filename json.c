@@ -1,11 +1,24 @@
 #include <assert.h>
+#include <math.h>
 
 #include <glib.h>
 #include <jansson.h>
 
 #include "data.h"
+#include "histogram.h"
+#include "skew.h"
 #include "timer.h"
 
+static const char *stage_names[MAX_STAGE] = {
+    [STAGE_WAKEUP_T0] = "wakeup-t0",
+    [STAGE_PROGRAM_WAKEUP] = "program-wakeup",
+    [STAGE_NETSCHED_PROGRAM] = "netsched-program",
+    [STAGE_DRIVER_NETSCHED] = "driver-netsched",
+    [STAGE_WIRE] = "wire",
+    [STAGE_RX_SW_HW] = "rx-sw-hw",
+    [STAGE_RX_PROGRAM_SW] = "rx-program-sw",
+};
+
 int add_json_timestamp(json_t *object, char *name, struct timespec ts)
 {
     char *s;
@@ -63,26 +76,279 @@ json_t *json_test_packet(struct ether_testpacket *tp1,
     add_json_timestamp(timestamps, "tx-kernel-hardware", tp2->timestamps[TS_LAST_KERNEL_SW_TX]);
 
     add_json_timestamp(timestamps, "rx-hardware", tss[TS_KERNEL_HW_RX]);
-    //add_json_timestamp(timestamps, "rx-kernel-driver", &tss[TS_KERNEL_SW_RX]);
+    add_json_timestamp(timestamps, "rx-kernel-driver", tss[TS_KERNEL_SW_RX]);
     add_json_timestamp(timestamps, "rx-program", tss[TS_PROG_RECV]);
 
     return root;
 }
 
-json_t *json_error(struct result *result)
+json_t *json_error(int stream_id, struct result *result)
 {
     json_t *j;
 
-    j = json_pack("{sss{sisb}}",
+    j = json_pack("{sss{sisisbsisisi}}",
                   "type", "rx-error",
                   "object",
+                  "stream-id", stream_id,
                   "dropped-packets", result->dropped,
-                  "sequence-error", result->seq_error
+                  "sequence-error", result->seq_error,
+                  "sender-overrun", result->sender_overrun,
+                  "local-overflow", result->local_overflow,
+                  "network-loss", result->network_loss
+    );
+
+    return j;
+}
+
+/*
+ * The sender has missed intervals, the count is in the upper bits of the
+ * flags and the marker carries the start of the first missed interval.
+ */
+json_t *json_overrun(struct ether_testpacket *tp)
+{
+    struct timespec ts_t0;
+    struct timespec ts_wakeup;
+    char *t0;
+    char *wakeup;
+    json_t *j;
+
+    /* copy the timestamps to avoid unaligned pointer compiler errors */
+    memcpy(&ts_t0, &tp->timestamps[TS_T0], sizeof(ts_t0));
+    memcpy(&ts_wakeup, &tp->timestamps[TS_WAKEUP], sizeof(ts_wakeup));
+    t0 = timespec_to_iso_string(&ts_t0);
+    wakeup = timespec_to_iso_string(&ts_wakeup);
+
+    j = json_pack("{sss{sisIsissss}}",
+                  "type", "tx-overrun",
+                  "object",
+                  "stream-id", tp->stream_id,
+                  "sequence-number", (json_int_t)tp->seq,
+                  "missed-intervals", TP_OVERRUNS(tp->flags),
+                  "interval-start", t0,
+                  "tx-wakeup", wakeup
+    );
+
+    g_free(t0);
+    g_free(wakeup);
+
+    return j;
+}
+
+json_t *json_socket_stats(struct socket_stats *stats)
+{
+    json_t *j;
+
+    j = json_pack("{sss{sIsIsI}}",
+                  "type", "rx-socket-stats",
+                  "object",
+                  "packets", (json_int_t)stats->packets,
+                  "drops", (json_int_t)stats->drops,
+                  "freeze-queue-count", (json_int_t)stats->freeze_q_cnt
+    );
+
+    return j;
+}
+
+/* stage deltas in nsec, missing stages are null */
+json_t *json_decomposition(struct decomposition *d)
+{
+    json_t *stages = json_object();
+    int i;
+
+    for (i = 0; i < MAX_STAGE; i++) {
+        json_object_set_new(stages, stage_names[i],
+                d->valid[i] ? json_integer(d->delta[i]) : json_null());
+    }
+
+    return json_pack("{sss{sisIso}}",
+                  "type", "rx-decomposition",
+                  "object",
+                  "stream-id", d->stream_id,
+                  "sequence-number", (json_int_t)d->seq,
+                  "stages-ns", stages
+    );
+}
+
+json_t *json_decomposition_summary(struct histogram *hists,
+        guint64 *missing)
+{
+    json_t *stages = json_object();
+    int i;
+
+    for (i = 0; i < MAX_STAGE; i++) {
+        struct histogram *h = &hists[i];
+        json_t *stage;
+
+        stage = json_pack("{sIsIsIsI}",
+                "count", (json_int_t)h->count,
+                "missing", (json_int_t)missing[i],
+                "min", (json_int_t)(h->count ? h->min : 0),
+                "max", (json_int_t)(h->count ? h->max : 0));
+        json_object_set_new(stage, "mean",
+                json_integer(h->count ? h->sum / (gint64)h->count : 0));
+        json_object_set_new(stage, "p50",
+                json_integer(histogram_percentile(h, 50.0)));
+        json_object_set_new(stage, "p99",
+                json_integer(histogram_percentile(h, 99.0)));
+        json_object_set_new(stage, "p99.9",
+                json_integer(histogram_percentile(h, 99.9)));
+        json_object_set_new(stages, stage_names[i], stage);
+    }
+
+    return json_pack("{sss{so}}",
+                  "type", "rx-decomposition-summary",
+                  "object",
+                  "stages-ns", stages
+    );
+}
+
+static const char *self_stage_names[MAX_SELF_STAGE] = {
+    [SELF_ANALYSIS] = "analysis",
+    [SELF_FORMAT] = "format",
+    [SELF_WRITE] = "write",
+    [SELF_TOTAL] = "total",
+};
+
+json_t *json_self_stats(struct self_stats *stats)
+{
+    json_t *stages = json_object();
+    gdouble seconds = stats->interval_ns / 1e9;
+    gint64 cpu_usec = stats->utime_usec + stats->stime_usec;
+    int i;
+
+    for (i = 0; i < MAX_SELF_STAGE; i++) {
+        struct histogram *h = &stats->stages[i];
+
+        json_object_set_new(stages, self_stage_names[i],
+                json_pack("{sIsIsIsI}",
+                    "p50", (json_int_t)histogram_percentile(h, 50.0),
+                    "p99", (json_int_t)histogram_percentile(h, 99.0),
+                    "p99.9", (json_int_t)histogram_percentile(h, 99.9),
+                    "max", (json_int_t)(h->count ? h->max : 0)));
+    }
+
+    return json_pack("{sss{sIsIsfsIsIsfsIsIso}}",
+                  "type", "rx-self",
+                  "object",
+                  "interval-ns", (json_int_t)stats->interval_ns,
+                  "packets", (json_int_t)stats->packets,
+                  "packets-per-sec",
+                      seconds > 0 ? stats->packets / seconds : 0.0,
+                  "cpu-user-usec", (json_int_t)stats->utime_usec,
+                  "cpu-system-usec", (json_int_t)stats->stime_usec,
+                  "cpu-percent",
+                      seconds > 0 ? cpu_usec / seconds / 1e4 : 0.0,
+                  "cpu-ns-per-packet", (json_int_t)(stats->packets
+                      ? cpu_usec * 1000 / (gint64)stats->packets : 0),
+                  "max-rss-kb", (json_int_t)stats->max_rss_kb,
+                  "stages-ns", stages
     );
+}
+
+/*
+ * Members of the rx-event record of a threshold violation, the value and
+ * the threshold are in nsec for latency and jitter and in packets for loss.
+ */
+json_t *json_event_info(const char *reason, struct ether_testpacket *tp,
+        struct timespec *rx_ts, gint64 value, gint64 threshold)
+{
+    char *time = timespec_to_iso_string(rx_ts);
+    json_t *j;
+
+    j = json_pack("{sssIsssIsI}",
+                  "reason", reason,
+                  "sequence-number", (json_int_t)tp->seq,
+                  "rx-program", time,
+                  "value", (json_int_t)value,
+                  "threshold", (json_int_t)threshold
+    );
+
+    g_free(time);
 
     return j;
 }
 
+json_t *json_summary(int stream_id, struct rx_summary *summary)
+{
+    struct histogram *h = &summary->latency;
+
+    return json_pack("{sss{sisIsIsIsIsIsIs{sIsIsIsIsIsI}}}",
+                  "type", "rx-summary",
+                  "object",
+                  "stream-id", stream_id,
+                  "interval-ns", (json_int_t)summary->interval_ns,
+                  "packets", (json_int_t)summary->packets,
+                  "dropped-packets", (json_int_t)summary->dropped,
+                  "sequence-errors", (json_int_t)summary->seq_errors,
+                  "events", (json_int_t)summary->events,
+                  "suppressed-events", (json_int_t)summary->suppressed,
+                  "latency-ns",
+                  "count", (json_int_t)h->count,
+                  "min", (json_int_t)(h->count ? h->min : 0),
+                  "p50", (json_int_t)histogram_percentile(h, 50.0),
+                  "p99", (json_int_t)histogram_percentile(h, 99.0),
+                  "p99.9", (json_int_t)histogram_percentile(h, 99.9),
+                  "max", (json_int_t)(h->count ? h->max : 0)
+    );
+}
+
+json_t *json_breaktrace(struct ether_testpacket *tp, gint64 latency,
+        gint64 threshold)
+{
+    return json_pack("{sss{sisIsIsI}}",
+                  "type", "rx-breaktrace",
+                  "object",
+                  "stream-id", tp->stream_id,
+                  "sequence-number", (json_int_t)tp->seq,
+                  "latency-ns", (json_int_t)latency,
+                  "threshold-ns", (json_int_t)threshold
+    );
+}
+
+/*
+ * The clock estimate of a stream: the lower envelope of the one-way delay,
+ * i.e. the clock offset plus the minimum path delay, its change since the
+ * first window, the drift and the residual of the window minima.
+ */
+json_t *json_clock(int stream_id, struct skew *s)
+{
+    return json_pack("{sss{sisIsIsIsIsfsI}}",
+                  "type", "rx-clock",
+                  "object",
+                  "stream-id", stream_id,
+                  "windows", (json_int_t)s->windows,
+                  "window-min-ns", (json_int_t)s->last_min_delay,
+                  "envelope-ns",
+                      (json_int_t)skew_envelope(s, s->last_min_t),
+                  "wander-ns",
+                      (json_int_t)skew_correction(s, s->last_min_t),
+                  "drift-ppm", skew_drift_ppm(s),
+                  "residual-ns", (json_int_t)llround(s->residual)
+    );
+}
+
+/* the corrected latency is null until the clock estimate is valid */
+void json_add_latency(json_t *j, gint64 latency, const gint64 *corrected)
+{
+    json_t *object = json_object_get(j, "object");
+
+    json_object_set_new(object, "latency-ns", json_integer(latency));
+    json_object_set_new(object, "latency-corrected-ns",
+            corrected ? json_integer(*corrected) : json_null());
+}
+
+/* the counters of nl-rx --reflect */
+json_t *json_reflect(guint64 reflected, guint64 ignored, guint64 send_errors)
+{
+    return json_pack("{sss{sIsIsI}}",
+                  "type", "rx-reflect",
+                  "object",
+                  "reflected", (json_int_t)reflected,
+                  "ignored", (json_int_t)ignored,
+                  "send-errors", (json_int_t)send_errors
+    );
+}
+
 void dump_json_stdout(struct json_t *j)
 {
     char *s = json_dumps(j, JSON_COMPACT);
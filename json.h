@@ -1,12 +1,40 @@
 #ifndef __JSON_H__
 #define __JSON_H__
 
+struct skew;
+
 int add_json_timestamp(json_t *object, char *name, struct timespec ts);
 
 json_t *json_test_packet(struct ether_testpacket *tp1,
         struct ether_testpacket *tp2, struct timespec *tss);
 
-json_t *json_error(struct result *result);
+json_t *json_error(int stream_id, struct result *result);
+
+json_t *json_overrun(struct ether_testpacket *tp);
+
+json_t *json_socket_stats(struct socket_stats *stats);
+
+json_t *json_decomposition(struct decomposition *d);
+
+json_t *json_decomposition_summary(struct histogram *hists,
+        guint64 *missing);
+
+json_t *json_self_stats(struct self_stats *stats);
+
+json_t *json_event_info(const char *reason, struct ether_testpacket *tp,
+        struct timespec *rx_ts, gint64 value, gint64 threshold);
+
+json_t *json_summary(int stream_id, struct rx_summary *summary);
+
+json_t *json_breaktrace(struct ether_testpacket *tp, gint64 latency,
+        gint64 threshold);
+
+json_t *json_clock(int stream_id, struct skew *s);
+
+void json_add_latency(json_t *j, gint64 latency, const gint64 *corrected);
+
+json_t *json_reflect(guint64 reflected, guint64 ignored,
+        guint64 send_errors);
 
 void dump_json_stdout(struct json_t *j);
 
@@ -29,15 +29,18 @@ A network latency measurement toolset.
 %files
 /usr/sbin/nl-rx
 /usr/sbin/nl-tx
+/usr/bin/nl-stat
 /usr/bin/nl-report
 /usr/bin/nl-calc
 /usr/bin/nl-trace
 /usr/bin/nl-xlat-ts
+/usr/share/netlatency
 # Man Pages get auto-compressed by rpm's buildroot policy scripts.
 # https://fedoraproject.org/wiki/Packaging:Guidelines#Manpages 
 %{_mandir}/man1/nl-rx.1*
 %{_mandir}/man1/nl-tx.1*
 %{_mandir}/man1/nl-report.1*
 %{_mandir}/man1/nl-calc.1*
+%{_mandir}/man1/nl-stat.1*
 %{_mandir}/man1/nl-trace.1*
 %{_mandir}/man1/nl-xlat-ts.1*
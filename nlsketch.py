@@ -0,0 +1,185 @@
+# Copyright (c) 2018, Kontron Europe GmbH
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+#    this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+#    this list of conditions and the following disclaimer in the documentation
+#    and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+"""Quantile sketch of the netlatency helper scripts.
+
+The buckets are log-linear: each power of two is divided into 2^SUB_BITS
+buckets, so a percentile is reported with a relative error of less than
+1/2^SUB_BITS. Negative values are counted in mirrored buckets. The memory is
+fixed, independent of the number of samples.
+
+The scheme is the one of histogram.c, but with finer buckets over a wider
+range (SUB_BITS 7 and MAX_BITS 48 against HIST_SUB_BITS 4 and HIST_MAX_BITS
+40), i.e. a relative error below 1/128 instead of 1/16. The buckets are not
+compatible with those of the histograms of nl-tx, nl-rx and nl-stat.
+"""
+
+from __future__ import division
+
+import math
+import numpy
+
+SUB_BITS = 7
+SUB_BUCKETS = 1 << SUB_BITS
+# larger magnitudes end up in the last bucket, min and max stay exact
+MAX_BITS = 48
+MAX_VALUE = (1 << MAX_BITS) - 1
+NUM_BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS
+
+# percentiles of QuantileSketch.summary()
+PERCENTILES = (50, 90, 99, 99.9, 99.99, 99.999, 99.9999)
+
+# values pushed one by one are added in batches of this size
+PUSH_SIZE = 4096
+
+
+def bucket(values):
+    """Bucket indexes of non-negative int64 values."""
+    values = numpy.minimum(values, MAX_VALUE)
+    # exact, MAX_VALUE fits into the float64 mantissa
+    msb = numpy.frexp(values.astype(numpy.float64))[1].astype(numpy.int64) - 1
+    shift = numpy.maximum(msb - SUB_BITS, 0)
+    index = (msb - SUB_BITS + 1) * SUB_BUCKETS \
+            + ((values >> shift) & (SUB_BUCKETS - 1))
+    return numpy.where(values < SUB_BUCKETS, values, index)
+
+def bucket_lower(index):
+    group = index // SUB_BUCKETS
+    if group == 0:
+        return index
+    return (SUB_BUCKETS + index % SUB_BUCKETS) << (group - 1)
+
+def bucket_upper(index):
+    group = index // SUB_BUCKETS
+    if group == 0:
+        return index
+    return bucket_lower(index) + (1 << (group - 1)) - 1
+
+
+class QuantileSketch(object):
+    def __init__(self):
+        self.count = 0
+        self.min = 0
+        self.max = 0
+        self.positive = numpy.zeros(NUM_BUCKETS, dtype=numpy.int64)
+        # indexed by the magnitude of negative values
+        self.negative = numpy.zeros(NUM_BUCKETS, dtype=numpy.int64)
+        self.pending = []
+
+    def add(self, values):
+        """Add an array of integer values."""
+        values = numpy.asarray(values, dtype=numpy.int64)
+        if not len(values):
+            return
+
+        vmin = int(values.min())
+        vmax = int(values.max())
+        if not self.count:
+            self.min, self.max = vmin, vmax
+        else:
+            self.min = min(self.min, vmin)
+            self.max = max(self.max, vmax)
+        self.count += len(values)
+
+        negative = values < 0
+        self.positive += numpy.bincount(bucket(values[~negative]),
+                minlength=NUM_BUCKETS)
+        if negative.any():
+            magnitude = -numpy.maximum(values[negative], -MAX_VALUE)
+            self.negative += numpy.bincount(bucket(magnitude),
+                    minlength=NUM_BUCKETS)
+
+    def push(self, value):
+        """Add a single value, cheap enough to be called per sample."""
+        self.pending.append(value)
+        if len(self.pending) >= PUSH_SIZE:
+            self.flush()
+
+    def flush(self):
+        if self.pending:
+            pending = self.pending
+            self.pending = []
+            self.add(pending)
+
+    def merge(self, other):
+        other.flush()
+        self.flush()
+        if not other.count:
+            return
+        if not self.count:
+            self.min, self.max = other.min, other.max
+        else:
+            self.min = min(self.min, other.min)
+            self.max = max(self.max, other.max)
+        self.count += other.count
+        self.positive += other.positive
+        self.negative += other.negative
+
+    def percentiles(self, percentiles):
+        """Values of the given percentiles. Each is the bound of its bucket
+        farther from zero, limited to the observed minimum and maximum."""
+        self.flush()
+        if not self.count:
+            return [0] * len(percentiles)
+
+        # buckets in ascending order of their values
+        counts = numpy.cumsum(numpy.concatenate((self.negative[::-1],
+                self.positive)))
+        result = []
+        for percentile in percentiles:
+            rank = int(math.ceil(percentile / 100.0 * self.count))
+            rank = min(max(rank, 1), self.count)
+            i = int(numpy.searchsorted(counts, rank))
+            if i < NUM_BUCKETS:
+                value = -bucket_upper(NUM_BUCKETS - 1 - i)
+            else:
+                value = bucket_upper(i - NUM_BUCKETS)
+            result.append(min(max(value, self.min), self.max))
+        return result
+
+    def buckets(self):
+        """Values and counts of the non-empty buckets in ascending order, each
+        value as percentiles() would report it."""
+        self.flush()
+        negative = numpy.flatnonzero(self.negative)[::-1]
+        positive = numpy.flatnonzero(self.positive)
+        values = [-bucket_upper(i) for i in negative.tolist()] \
+                + [bucket_upper(i) for i in positive.tolist()]
+        values = numpy.clip(numpy.array(values, dtype=numpy.int64),
+                self.min, self.max)
+        counts = numpy.concatenate((self.negative[negative],
+                self.positive[positive]))
+        return values, counts
+
+    def percentile(self, percentile):
+        return self.percentiles([percentile])[0]
+
+    def summary(self):
+        """count, min, the PERCENTILES as p50, p99.9 etc. and max"""
+        self.flush()
+        summary = {'count': self.count, 'min': self.min}
+        for p, value in zip(PERCENTILES, self.percentiles(PERCENTILES)):
+            summary['p%g' % p] = value
+        summary['max'] = self.max
+        return summary
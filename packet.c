@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2018, Kontron Europe GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+
+#include "packet.h"
+
+#define NSEC_PER_SEC 1000000000
+
+gsize tp_wire_len(guint8 version, guint num_timestamps)
+{
+    num_timestamps = MIN(num_timestamps, TS_MAX_NUM);
+
+    switch (version) {
+    case TP_VERSION_1:
+        return TP_LEN(num_timestamps);
+    case TP_VERSION_2:
+        return TP_V2_LEN(num_timestamps);
+    default:
+        return 0;
+    }
+}
+
+static gint64 timespec_to_ns(const struct timespec *ts)
+{
+    return (gint64)ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+static void ns_to_timespec(gint64 ns, struct timespec *ts)
+{
+    ts->tv_sec = ns / NSEC_PER_SEC;
+    ts->tv_nsec = ns % NSEC_PER_SEC;
+    if (ts->tv_nsec < 0) {
+        ts->tv_nsec += NSEC_PER_SEC;
+        ts->tv_sec--;
+    }
+}
+
+static void encode_v1(const struct ether_testpacket *tp, guint num,
+        struct ether_testpacket_v1 *v1)
+{
+    memcpy(&v1->hdr, &tp->hdr, sizeof(v1->hdr));
+    v1->version = TP_VERSION_1;
+    v1->stream_id = tp->stream_id;
+    v1->seq = tp->seq;
+    v1->interval_usec = tp->interval_usec;
+    v1->offset_usec = tp->offset_usec;
+    v1->flags = tp->flags;
+    memcpy(v1->timestamps, tp->timestamps, sizeof(struct timespec) * num);
+}
+
+/* the interval and the offset must fit the 32 bit nsec fields of v2 */
+static int encode_v2(const struct ether_testpacket *tp, guint num,
+        struct ether_testpacket_v2 *v2)
+{
+    gint64 interval_ns = (gint64)tp->interval_usec * 1000;
+    gint64 offset_ns = (gint64)tp->offset_usec * 1000;
+    guint i;
+
+    if (interval_ns > G_MAXUINT32
+            || offset_ns < G_MININT32 || offset_ns > G_MAXINT32) {
+        return -1;
+    }
+
+    memcpy(&v2->hdr, &tp->hdr, sizeof(v2->hdr));
+    v2->version = TP_VERSION_2;
+    v2->stream_id = tp->stream_id;
+    v2->reserved = 0;
+    v2->flags = GUINT32_TO_LE(tp->flags);
+    v2->seq = GUINT64_TO_LE(tp->seq);
+    v2->interval_ns = GUINT32_TO_LE((guint32)interval_ns);
+    v2->offset_ns = GINT32_TO_LE((gint32)offset_ns);
+    for (i = 0; i < num; i++) {
+        struct timespec ts = tp->timestamps[i];
+        gint64 ns = 0;
+
+        if (ts.tv_sec || ts.tv_nsec) {
+            ns = timespec_to_ns(&ts);
+        }
+        v2->timestamps[i] = GINT64_TO_LE(ns);
+    }
+
+    return 0;
+}
+
+gssize tp_encode(const struct ether_testpacket *tp, guint num_timestamps,
+        void *buf, gsize size)
+{
+    gsize len;
+
+    num_timestamps = MIN(num_timestamps, TS_MAX_NUM);
+    len = tp_wire_len(tp->version, num_timestamps);
+    if (len == 0 || len > size) {
+        return -1;
+    }
+
+    if (tp->version == TP_VERSION_1) {
+        encode_v1(tp, num_timestamps, buf);
+    } else if (encode_v2(tp, num_timestamps, buf) < 0) {
+        return -1;
+    }
+
+    return len;
+}
+
+static void decode_v1(const struct ether_testpacket_v1 *v1, guint num,
+        struct ether_testpacket *tp)
+{
+    tp->stream_id = v1->stream_id;
+    tp->seq = v1->seq;
+    tp->interval_usec = v1->interval_usec;
+    tp->offset_usec = v1->offset_usec;
+    tp->flags = v1->flags;
+    memcpy(tp->timestamps, v1->timestamps, sizeof(struct timespec) * num);
+}
+
+static void decode_v2(const struct ether_testpacket_v2 *v2, guint num,
+        struct ether_testpacket *tp)
+{
+    guint i;
+
+    tp->stream_id = v2->stream_id;
+    tp->seq = GUINT64_FROM_LE(v2->seq);
+    tp->interval_usec = GUINT32_FROM_LE(v2->interval_ns) / 1000;
+    tp->offset_usec = GINT32_FROM_LE(v2->offset_ns) / 1000;
+    tp->flags = GUINT32_FROM_LE(v2->flags);
+    for (i = 0; i < num; i++) {
+        gint64 ns = GINT64_FROM_LE(v2->timestamps[i]);
+
+        if (ns) {
+            ns_to_timespec(ns, &tp->timestamps[i]);
+        }
+    }
+}
+
+/* write a timestamp into a frame in the format of its version */
+static void set_wire_timestamp(void *buf, int slot, const struct timespec *ts)
+{
+    guint8 *frame = buf;
+
+    if (frame[offsetof(struct ether_testpacket_v1, version)]
+            == TP_VERSION_1) {
+        memcpy(frame + TP_LEN(slot), ts, sizeof(*ts));
+    } else {
+        gint64 ns = GINT64_TO_LE(timespec_to_ns(ts));
+        memcpy(frame + TP_V2_LEN(slot), &ns, sizeof(ns));
+    }
+}
+
+gssize tp_reflect(void *buf, gsize len, gsize size, const guint8 *addr,
+        const struct timespec *rx_ts)
+{
+    struct ether_header *hdr = buf;
+    guint8 *frame = buf;
+    guint8 version;
+    gsize flags_offset;
+    gsize min_len;
+    guint32 flags;
+
+    if (len < TP_HDR_LEN) {
+        return -1;
+    }
+
+    version = frame[offsetof(struct ether_testpacket_v1, version)];
+    switch (version) {
+    case TP_VERSION_1:
+        flags_offset = offsetof(struct ether_testpacket_v1, flags);
+        break;
+    case TP_VERSION_2:
+        flags_offset = offsetof(struct ether_testpacket_v2, flags);
+        break;
+    default:
+        return -1;
+    }
+
+    min_len = tp_wire_len(version, TS_REFLECT_TX + 1);
+    if (len < flags_offset + sizeof(flags) || min_len > size) {
+        return -1;
+    }
+
+    memcpy(&flags, frame + flags_offset, sizeof(flags));
+    if (version == TP_VERSION_2) {
+        flags = GUINT32_FROM_LE(flags);
+    }
+    if (flags & (TP_FLAG_FOLLOW_UP | TP_FLAG_OVERRUN_MARKER
+                | TP_FLAG_REFLECTED)) {
+        return -1;
+    }
+
+    flags |= TP_FLAG_REFLECTED;
+    if (version == TP_VERSION_2) {
+        flags = GUINT32_TO_LE(flags);
+    }
+    memcpy(frame + flags_offset, &flags, sizeof(flags));
+
+    if (len < min_len) {
+        memset(frame + len, 0, min_len - len);
+        len = min_len;
+    }
+
+    memcpy(hdr->ether_dhost, hdr->ether_shost, ETH_ALEN);
+    memcpy(hdr->ether_shost, addr, ETH_ALEN);
+
+    set_wire_timestamp(buf, TS_REFLECT_RX, rx_ts);
+
+    return len;
+}
+
+void tp_reflect_set_tx(void *buf, const struct timespec *tx_ts)
+{
+    set_wire_timestamp(buf, TS_REFLECT_TX, tx_ts);
+}
+
+int tp_decode(const void *buf, gsize len, struct ether_testpacket *tp)
+{
+    const struct ether_testpacket_v1 *v1 = buf;
+    gsize hdr_len;
+    gsize ts_len;
+    guint num;
+
+    memset(tp, 0, sizeof(*tp));
+
+    /* the version is at the same offset in all formats */
+    if (len < TP_HDR_LEN) {
+        return -1;
+    }
+
+    switch (v1->version) {
+    case TP_VERSION_1:
+        hdr_len = TP_HDR_LEN;
+        ts_len = sizeof(struct timespec);
+        break;
+    case TP_VERSION_2:
+        hdr_len = TP_V2_HDR_LEN;
+        ts_len = sizeof(gint64);
+        break;
+    default:
+        return -1;
+    }
+
+    if (len < hdr_len) {
+        return -1;
+    }
+    num = MIN((len - hdr_len) / ts_len, TS_MAX_NUM);
+
+    memcpy(&tp->hdr, &v1->hdr, sizeof(tp->hdr));
+    tp->version = v1->version;
+    if (v1->version == TP_VERSION_1) {
+        decode_v1(buf, num, tp);
+    } else {
+        decode_v2(buf, num, tp);
+    }
+
+    return 0;
+}
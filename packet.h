@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2018, Kontron Europe GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PACKET_H__
+#define __PACKET_H__
+
+#include "data.h"
+
+/* length of a frame with the given number of timestamps on the wire */
+gsize tp_wire_len(guint8 version, guint num_timestamps);
+
+/*
+ * Convert a test packet to the wire format of its version, with the first
+ * num_timestamps timestamps. Returns the frame length or -1 if the version
+ * is unknown or the buffer is too small.
+ */
+gssize tp_encode(const struct ether_testpacket *tp, guint num_timestamps,
+        void *buf, gsize size);
+
+/*
+ * Convert a received frame to host representation. Timestamps beyond the
+ * frame length are zero. Returns -1 for unknown versions and short frames.
+ */
+int tp_decode(const void *buf, gsize len, struct ether_testpacket *tp);
+
+/*
+ * Turn a received test frame into its reflection in place: the addresses
+ * are swapped, the reflected flag is set and rx_ts is written as the
+ * receive time of the reflector. Frames too short for the reflector
+ * timestamps are extended up to size. Returns the length of the reflected
+ * frame or -1 for frames which are not reflected, i.e. unknown versions,
+ * follow-ups, overrun markers and reflections.
+ */
+gssize tp_reflect(void *buf, gsize len, gsize size, const guint8 *addr,
+        const struct timespec *rx_ts);
+
+/* write the send time of the reflector, right before sending */
+void tp_reflect_set_tx(void *buf, const struct timespec *tx_ts);
+
+#endif /* __PACKET_H__ */
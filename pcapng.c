@@ -0,0 +1,451 @@
+/*
+ * Copyright (c) 2018, Kontron Europe GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+
+#include "data.h"
+#include "pcapng.h"
+
+#define PCAPNG_SHB 0x0a0d0d0a
+#define PCAPNG_IDB 0x00000001
+#define PCAPNG_EPB 0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1a2b3c4d
+
+#define PCAPNG_OPT_ENDOFOPT 0
+#define PCAPNG_OPT_COMMENT 1
+#define PCAPNG_IF_TSRESOL 9
+
+#define PCAPNG_LINKTYPE_ETHERNET 1
+#define PCAPNG_MAX_INTERFACES 16
+#define PCAPNG_MAX_BLOCK_LEN (16 * 1024 * 1024)
+
+#define PAD4(x) (((x) + 3) & ~3)
+
+#define NSEC_PER_SEC 1000000000LL
+
+struct pcapng_file {
+    FILE *fp;
+    guint8 *block;
+    gsize block_size;
+
+    /* interfaces of the current section */
+    guint num_interfaces;
+    guint16 linktype[PCAPNG_MAX_INTERFACES];
+    guint64 ts_per_sec[PCAPNG_MAX_INTERFACES];
+};
+
+static const char *ts_names[MAX_TS_RX] = {
+    [TS_KERNEL_HW_RX] = "rx-hardware",
+    [TS_KERNEL_SW_RX] = "rx-kernel-driver",
+    [TS_PROG_RECV] = "rx-program",
+};
+
+static guint8 *block_reserve(struct pcapng_file *f, gsize len)
+{
+    if (len > f->block_size) {
+        f->block_size = MAX(len, 2 * f->block_size);
+        f->block = g_realloc(f->block, f->block_size);
+    }
+
+    return f->block;
+}
+
+static gsize put_option(guint8 *p, guint16 code, const void *value,
+        guint16 len)
+{
+    memcpy(p, &code, sizeof(code));
+    memcpy(p + 2, &len, sizeof(len));
+    memcpy(p + 4, value, len);
+    memset(p + 4 + len, 0, PAD4(len) - len);
+
+    return 4 + PAD4(len);
+}
+
+static int write_block(struct pcapng_file *f, guint32 type,
+        const guint8 *body, guint32 body_len)
+{
+    guint32 total = 12 + body_len;
+
+    if (fwrite(&type, sizeof(type), 1, f->fp) != 1
+            || fwrite(&total, sizeof(total), 1, f->fp) != 1
+            || fwrite(body, 1, body_len, f->fp) != body_len
+            || fwrite(&total, sizeof(total), 1, f->fp) != 1) {
+        perror("pcapng write");
+        return -1;
+    }
+
+    return 0;
+}
+
+static gint64 timespec_to_ns(const struct timespec *ts)
+{
+    return (gint64)ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+static void ns_to_timespec(gint64 ns, struct timespec *ts)
+{
+    ts->tv_sec = ns / NSEC_PER_SEC;
+    ts->tv_nsec = ns % NSEC_PER_SEC;
+}
+
+struct pcapng_file *pcapng_create(const gchar *path)
+{
+    struct pcapng_file *f;
+    guint8 body[32];
+    guint32 magic = PCAPNG_BYTE_ORDER_MAGIC;
+    guint16 major = 1;
+    guint16 minor = 0;
+    gint64 section_len = -1;
+    guint16 linktype = PCAPNG_LINKTYPE_ETHERNET;
+    guint32 snaplen = 0;
+    guint8 tsresol = 9;
+    gsize off;
+
+    f = g_new0(struct pcapng_file, 1);
+    f->fp = fopen(path, "wb");
+    if (f->fp == NULL) {
+        perror("fopen");
+        g_free(f);
+        return NULL;
+    }
+
+    /* section header block */
+    memcpy(body, &magic, 4);
+    memcpy(body + 4, &major, 2);
+    memcpy(body + 6, &minor, 2);
+    memcpy(body + 8, &section_len, 8);
+    if (write_block(f, PCAPNG_SHB, body, 16)) {
+        pcapng_close(f);
+        return NULL;
+    }
+
+    /* interface description block with nanosecond resolution */
+    memset(body, 0, sizeof(body));
+    memcpy(body, &linktype, 2);
+    memcpy(body + 4, &snaplen, 4);
+    off = 8;
+    off += put_option(body + off, PCAPNG_IF_TSRESOL, &tsresol, 1);
+    off += put_option(body + off, PCAPNG_OPT_ENDOFOPT, NULL, 0);
+    if (write_block(f, PCAPNG_IDB, body, off)) {
+        pcapng_close(f);
+        return NULL;
+    }
+
+    f->num_interfaces = 1;
+    f->linktype[0] = PCAPNG_LINKTYPE_ETHERNET;
+    f->ts_per_sec[0] = NSEC_PER_SEC;
+
+    return f;
+}
+
+int pcapng_write_packet(struct pcapng_file *f, const void *data, guint32 len,
+        struct timespec *rx_tss)
+{
+    char comment[128];
+    guint32 iface = 0;
+    guint32 ts_high, ts_low;
+    guint64 ts = 0;
+    gsize off;
+    guint8 *p;
+    int n, i;
+
+    /* the block timestamp is the most accurate one available */
+    for (i = 0; i < MAX_TS_RX; i++) {
+        ts = timespec_to_ns(&rx_tss[i]);
+        if (ts) {
+            break;
+        }
+    }
+    ts_high = ts >> 32;
+    ts_low = ts & 0xffffffff;
+
+    n = g_snprintf(comment, sizeof(comment),
+            "%s=%" G_GINT64_FORMAT " %s=%" G_GINT64_FORMAT
+            " %s=%" G_GINT64_FORMAT,
+            ts_names[TS_KERNEL_HW_RX],
+            timespec_to_ns(&rx_tss[TS_KERNEL_HW_RX]),
+            ts_names[TS_KERNEL_SW_RX],
+            timespec_to_ns(&rx_tss[TS_KERNEL_SW_RX]),
+            ts_names[TS_PROG_RECV],
+            timespec_to_ns(&rx_tss[TS_PROG_RECV]));
+
+    p = block_reserve(f, 20 + PAD4(len) + 4 + PAD4(n) + 4);
+    memcpy(p, &iface, 4);
+    memcpy(p + 4, &ts_high, 4);
+    memcpy(p + 8, &ts_low, 4);
+    memcpy(p + 12, &len, 4);
+    memcpy(p + 16, &len, 4);
+    memcpy(p + 20, data, len);
+    memset(p + 20 + len, 0, PAD4(len) - len);
+    off = 20 + PAD4(len);
+    off += put_option(p + off, PCAPNG_OPT_COMMENT, comment, n);
+    off += put_option(p + off, PCAPNG_OPT_ENDOFOPT, NULL, 0);
+
+    return write_block(f, PCAPNG_EPB, p, off);
+}
+
+struct pcapng_file *pcapng_open(const gchar *path)
+{
+    struct pcapng_file *f;
+
+    f = g_new0(struct pcapng_file, 1);
+    f->fp = fopen(path, "rb");
+    if (f->fp == NULL) {
+        perror("fopen");
+        g_free(f);
+        return NULL;
+    }
+
+    return f;
+}
+
+static guint64 tsresol_to_ts_per_sec(guint8 tsresol)
+{
+    guint64 ts_per_sec = 1;
+    guint8 exp = tsresol & 0x7f;
+    int i;
+
+    if (tsresol & 0x80) {
+        return (guint64)1 << MIN(exp, 63);
+    }
+
+    for (i = 0; i < MIN(exp, 19); i++) {
+        ts_per_sec *= 10;
+    }
+
+    return ts_per_sec;
+}
+
+static void parse_idb(struct pcapng_file *f, const guint8 *body, gsize len)
+{
+    guint idx = f->num_interfaces;
+    gsize off = 8;
+
+    if (idx >= PCAPNG_MAX_INTERFACES || len < 8) {
+        return;
+    }
+
+    memcpy(&f->linktype[idx], body, 2);
+    f->ts_per_sec[idx] = 1000000;
+
+    while (off + 4 <= len) {
+        guint16 code, opt_len;
+
+        memcpy(&code, body + off, 2);
+        memcpy(&opt_len, body + off + 2, 2);
+        if (code == PCAPNG_OPT_ENDOFOPT || off + 4 + opt_len > len) {
+            break;
+        }
+        if (code == PCAPNG_IF_TSRESOL && opt_len >= 1) {
+            f->ts_per_sec[idx] = tsresol_to_ts_per_sec(body[off + 4]);
+        }
+        off += 4 + PAD4(opt_len);
+    }
+
+    f->num_interfaces++;
+}
+
+static void parse_comment(const guint8 *value, guint16 len,
+        struct timespec *rx_tss)
+{
+    char comment[128];
+    char *p = comment;
+    int i;
+
+    len = MIN(len, sizeof(comment) - 1);
+    memcpy(comment, value, len);
+    comment[len] = '\0';
+
+    while (*p) {
+        char *end;
+
+        while (*p == ' ') {
+            p++;
+        }
+        for (i = 0; i < MAX_TS_RX; i++) {
+            gsize n = strlen(ts_names[i]);
+            if (!strncmp(p, ts_names[i], n) && p[n] == '=') {
+                ns_to_timespec(strtoll(p + n + 1, NULL, 10), &rx_tss[i]);
+                break;
+            }
+        }
+        end = strchr(p, ' ');
+        if (end == NULL) {
+            break;
+        }
+        p = end;
+    }
+}
+
+/* returns 1 if the block is an ethernet packet */
+static int parse_epb(struct pcapng_file *f, const guint8 *body, gsize len,
+        void *data, guint32 size, guint32 *caplen,
+        struct timespec *rx_tss)
+{
+    guint32 iface, ts_high, ts_low;
+    gboolean have_comment = FALSE;
+    guint64 ts, ts_per_sec;
+    gsize off;
+
+    if (len < 20) {
+        return -1;
+    }
+
+    memcpy(&iface, body, 4);
+    memcpy(&ts_high, body + 4, 4);
+    memcpy(&ts_low, body + 8, 4);
+    memcpy(caplen, body + 12, 4);
+
+    if (20 + (gsize)PAD4(*caplen) > len) {
+        return -1;
+    }
+    if (iface >= f->num_interfaces
+            || f->linktype[iface] != PCAPNG_LINKTYPE_ETHERNET) {
+        return 0;
+    }
+
+    memset(rx_tss, 0, sizeof(struct timespec) * MAX_TS_RX);
+    memcpy(data, body + 20, MIN(*caplen, size));
+
+    off = 20 + PAD4(*caplen);
+    while (off + 4 <= len) {
+        guint16 code, opt_len;
+
+        memcpy(&code, body + off, 2);
+        memcpy(&opt_len, body + off + 2, 2);
+        if (code == PCAPNG_OPT_ENDOFOPT || off + 4 + opt_len > len) {
+            break;
+        }
+        if (code == PCAPNG_OPT_COMMENT) {
+            parse_comment(body + off + 4, opt_len, rx_tss);
+            have_comment = TRUE;
+        }
+        off += 4 + PAD4(opt_len);
+    }
+
+    if (!have_comment) {
+        ts = ((guint64)ts_high << 32) | ts_low;
+        ts_per_sec = f->ts_per_sec[iface];
+        rx_tss[TS_PROG_RECV].tv_sec = ts / ts_per_sec;
+        rx_tss[TS_PROG_RECV].tv_nsec =
+            (ts % ts_per_sec) * NSEC_PER_SEC / ts_per_sec;
+    }
+
+    *caplen = MIN(*caplen, size);
+
+    return 1;
+}
+
+int pcapng_read_packet(struct pcapng_file *f, void *data, guint32 size,
+        guint32 *len, struct timespec *rx_tss)
+{
+    for (;;) {
+        guint32 hdr[2];
+        guint32 trailer;
+        guint8 *body;
+        gsize body_len;
+        size_t n;
+        int rc;
+
+        n = fread(hdr, 1, sizeof(hdr), f->fp);
+        if (n == 0 && feof(f->fp)) {
+            return 0;
+        }
+        if (n != sizeof(hdr)) {
+            fprintf(stderr, "pcapng: truncated block\n");
+            return -1;
+        }
+
+        if (hdr[1] < 12 || hdr[1] % 4 || hdr[1] > PCAPNG_MAX_BLOCK_LEN) {
+            fprintf(stderr, "pcapng: invalid block length %u\n", hdr[1]);
+            return -1;
+        }
+
+        body_len = hdr[1] - 12;
+        body = block_reserve(f, body_len + 4);
+        if (fread(body, 1, body_len + 4, f->fp) != body_len + 4) {
+            fprintf(stderr, "pcapng: truncated block\n");
+            return -1;
+        }
+        memcpy(&trailer, body + body_len, 4);
+        if (trailer != hdr[1]) {
+            fprintf(stderr, "pcapng: block length mismatch\n");
+            return -1;
+        }
+
+        switch (hdr[0]) {
+        case PCAPNG_SHB: {
+            guint32 magic;
+
+            if (body_len < 4) {
+                return -1;
+            }
+            memcpy(&magic, body, 4);
+            if (magic != PCAPNG_BYTE_ORDER_MAGIC) {
+                fprintf(stderr, "pcapng: unsupported byte order\n");
+                return -1;
+            }
+            /* interface ids are local to a section */
+            f->num_interfaces = 0;
+            break;
+        }
+        case PCAPNG_IDB:
+            parse_idb(f, body, body_len);
+            break;
+        case PCAPNG_EPB:
+            rc = parse_epb(f, body, body_len, data, size, len, rx_tss);
+            if (rc < 0) {
+                fprintf(stderr, "pcapng: invalid packet block\n");
+                return -1;
+            }
+            if (rc) {
+                return 1;
+            }
+            break;
+        default:
+            /* skip other blocks */
+            break;
+        }
+    }
+}
+
+void pcapng_close(struct pcapng_file *f)
+{
+    if (f == NULL) {
+        return;
+    }
+
+    if (f->fp) {
+        fclose(f->fp);
+    }
+    g_free(f->block);
+    g_free(f);
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2018, Kontron Europe GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PCAPNG_H__
+#define __PCAPNG_H__
+
+/*
+ * Minimal pcapng reader and writer for the frames received by nl-rx. A file
+ * has a single Ethernet interface with nanosecond resolution. The hardware,
+ * software and program receive timestamps of a frame are stored as nsec
+ * values in the comment option of its enhanced packet block, e.g.
+ * "rx-hardware=... rx-kernel-driver=... rx-program=...".
+ */
+struct pcapng_file;
+
+struct pcapng_file *pcapng_create(const gchar *path);
+
+/* rx_tss is indexed by TS_KERNEL_HW_RX, TS_KERNEL_SW_RX and TS_PROG_RECV */
+int pcapng_write_packet(struct pcapng_file *f, const void *data, guint32 len,
+        struct timespec *rx_tss);
+
+struct pcapng_file *pcapng_open(const gchar *path);
+
+/*
+ * Read the next packet into data, truncated to size bytes. Packets without
+ * a timestamp comment get the block timestamp as program timestamp.
+ * Returns 1 for a packet, 0 at the end of the file and -1 on errors.
+ */
+int pcapng_read_packet(struct pcapng_file *f, void *data, guint32 size,
+        guint32 *len, struct timespec *rx_tss);
+
+void pcapng_close(struct pcapng_file *f);
+
+#endif /* __PCAPNG_H__ */
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2018, Kontron Europe GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PROBES_H__
+#define __PROBES_H__
+
+/*
+ * USDT probes of the provider netlatency, see README. With sys/sdt.h each
+ * probe is a nop and a note in the ELF file, the arguments are only read
+ * by an attached tracer. Without it the probes compile to nothing.
+ */
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define NL_PROBE2(name, a1, a2) \
+    DTRACE_PROBE2(netlatency, name, a1, a2)
+#define NL_PROBE3(name, a1, a2, a3) \
+    DTRACE_PROBE3(netlatency, name, a1, a2, a3)
+#define NL_PROBE4(name, a1, a2, a3, a4) \
+    DTRACE_PROBE4(netlatency, name, a1, a2, a3, a4)
+#define NL_PROBE5(name, a1, a2, a3, a4, a5) \
+    DTRACE_PROBE5(netlatency, name, a1, a2, a3, a4, a5)
+#define NL_PROBE6(name, a1, a2, a3, a4, a5, a6) \
+    DTRACE_PROBE6(netlatency, name, a1, a2, a3, a4, a5, a6)
+#else
+#define NL_PROBE2(name, a1, a2) \
+    do { (void)(a1); (void)(a2); } while (0)
+#define NL_PROBE3(name, a1, a2, a3) \
+    do { (void)(a1); (void)(a2); (void)(a3); } while (0)
+#define NL_PROBE4(name, a1, a2, a3, a4) \
+    do { (void)(a1); (void)(a2); (void)(a3); (void)(a4); } while (0)
+#define NL_PROBE5(name, a1, a2, a3, a4, a5) \
+    do { (void)(a1); (void)(a2); (void)(a3); (void)(a4); (void)(a5); \
+    } while (0)
+#define NL_PROBE6(name, a1, a2, a3, a4, a5, a6) \
+    do { (void)(a1); (void)(a2); (void)(a3); (void)(a4); (void)(a5); \
+        (void)(a6); } while (0)
+#endif
+
+/* timestamps are passed as nsec since the epoch */
+#define NL_PROBE_NS(ts) ((gint64)(ts).tv_sec * 1000000000 + (ts).tv_nsec)
+
+#endif /* __PROBES_H__ */
@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2018, Kontron Europe GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include <jansson.h>
+
+#include "recorder.h"
+
+struct recorder_stream {
+    /* ring of the last records, oldest at head */
+    gchar **ring;
+    guint head;
+    guint len;
+
+    /* records still to be written for the running event */
+    guint post_left;
+    gboolean have_event;
+    gint64 last_event;
+
+    guint64 events;
+    guint64 suppressed;
+};
+
+struct recorder {
+    FILE *file;
+    guint num_streams;
+    guint pre;
+    guint post;
+    gint64 holdoff_ns;
+    guint64 last_id;
+    struct recorder_stream *streams;
+};
+
+struct recorder *recorder_new(const gchar *path, guint num_streams,
+        guint pre, guint post, gint64 holdoff_ns)
+{
+    struct recorder *r;
+    guint i;
+
+    r = g_new0(struct recorder, 1);
+    r->file = fopen(path, "w");
+    if (r->file == NULL) {
+        fprintf(stderr, "Cannot open event file %s: %s\n", path,
+                strerror(errno));
+        g_free(r);
+        return NULL;
+    }
+
+    r->num_streams = num_streams;
+    r->pre = pre;
+    r->post = post;
+    r->holdoff_ns = holdoff_ns;
+    r->streams = g_new0(struct recorder_stream, num_streams);
+    for (i = 0; i < num_streams; i++) {
+        r->streams[i].ring = g_new0(gchar *, MAX(pre, 1));
+    }
+
+    return r;
+}
+
+static void write_record(struct recorder *r, const char *record)
+{
+    fputs(record, r->file);
+    fputc('\n', r->file);
+}
+
+void recorder_add(struct recorder *r, guint stream, const char *record)
+{
+    struct recorder_stream *s = &r->streams[stream];
+
+    if (s->post_left) {
+        write_record(r, record);
+        if (--s->post_left == 0) {
+            fflush(r->file);
+        }
+        return;
+    }
+
+    if (r->pre == 0) {
+        return;
+    }
+
+    if (s->len == r->pre) {
+        g_free(s->ring[s->head]);
+        s->ring[s->head] = g_strdup(record);
+        s->head = (s->head + 1) % r->pre;
+    } else {
+        s->ring[(s->head + s->len) % r->pre] = g_strdup(record);
+        s->len++;
+    }
+}
+
+/* write the ring oldest first and empty it, its records are not repeated */
+static void flush_ring(struct recorder *r, struct recorder_stream *s)
+{
+    while (s->len) {
+        write_record(r, s->ring[s->head]);
+        g_free(s->ring[s->head]);
+        s->ring[s->head] = NULL;
+        s->head = (s->head + 1) % r->pre;
+        s->len--;
+    }
+    s->head = 0;
+}
+
+guint64 recorder_trigger(struct recorder *r, guint stream, gint64 now_ns,
+        json_t *info)
+{
+    struct recorder_stream *s = &r->streams[stream];
+    json_t *j;
+    char *str;
+
+    if (s->post_left) {
+        json_decref(info);
+        return 0;
+    }
+
+    if (s->have_event && now_ns - s->last_event < r->holdoff_ns) {
+        s->suppressed++;
+        json_decref(info);
+        return 0;
+    }
+
+    s->have_event = TRUE;
+    s->last_event = now_ns;
+    s->events++;
+    r->last_id++;
+
+    json_object_set_new(info, "event-id", json_integer(r->last_id));
+    json_object_set_new(info, "stream-id", json_integer(stream));
+    json_object_set_new(info, "pre-records", json_integer(s->len));
+    json_object_set_new(info, "suppressed", json_integer(s->suppressed));
+    j = json_pack("{ssso}", "type", "rx-event", "object", info);
+    str = json_dumps(j, JSON_COMPACT);
+    if (str) {
+        write_record(r, str);
+        free(str);
+    }
+    json_decref(j);
+
+    flush_ring(r, s);
+    s->post_left = r->post;
+    fflush(r->file);
+
+    return r->last_id;
+}
+
+void recorder_stream_stats(struct recorder *r, guint stream,
+        guint64 *events, guint64 *suppressed)
+{
+    *events = r->streams[stream].events;
+    *suppressed = r->streams[stream].suppressed;
+}
+
+void recorder_free(struct recorder *r)
+{
+    guint i, n;
+
+    if (r == NULL) {
+        return;
+    }
+
+    for (i = 0; i < r->num_streams; i++) {
+        for (n = 0; n < MAX(r->pre, 1); n++) {
+            g_free(r->streams[i].ring[n]);
+        }
+        g_free(r->streams[i].ring);
+    }
+    g_free(r->streams);
+    fclose(r->file);
+    g_free(r);
+}
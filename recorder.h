@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2018, Kontron Europe GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __RECORDER_H__
+#define __RECORDER_H__
+
+#define RECORDER_DEFAULT_PRE 100
+#define RECORDER_DEFAULT_POST 100
+#define RECORDER_DEFAULT_HOLDOFF_MS 1000
+
+struct recorder;
+
+/*
+ * Flight recorder of the per packet records of each stream. The last pre
+ * records of a stream are kept in memory. An event writes them and the next
+ * post records of the stream to the event file.
+ */
+struct recorder *recorder_new(const gchar *path, guint num_streams,
+        guint pre, guint post, gint64 holdoff_ns);
+
+/* keep a record, or write it if the stream has a running event */
+void recorder_add(struct recorder *r, guint stream, const char *record);
+
+/*
+ * Start an event on the stream at time now_ns. The rx-event record carries
+ * the members of info, the event id and the stream id, info is stolen.
+ * Triggers while an event of the stream is running belong to that event,
+ * triggers within the holdoff time after the start of the last event are
+ * suppressed. Returns the event id or 0 if no event was started.
+ */
+guint64 recorder_trigger(struct recorder *r, guint stream, gint64 now_ns,
+        json_t *info);
+
+/* number of events started and triggers suppressed on a stream */
+void recorder_stream_stats(struct recorder *r, guint stream,
+        guint64 *events, guint64 *suppressed);
+
+void recorder_free(struct recorder *r);
+
+#endif /* __RECORDER_H__ */
@@ -41,8 +41,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <sys/un.h>
 #include <unistd.h>
@@ -53,7 +55,16 @@
 #include <jansson.h>
 
 #include "data.h"
+#include "ftrace.h"
+#include "histogram.h"
 #include "json.h"
+#include "packet.h"
+#include "pcapng.h"
+#include "probes.h"
+#include "recorder.h"
+#include "skew.h"
+#include "stats.h"
+#include "stream.h"
 #include "timer.h"
 
 #ifndef VERSION
@@ -67,15 +78,87 @@ static struct result results[MAX_STREAM_ID];
 static gchar *help_description = NULL;
 static gint o_capture_ethertype = TP_ETHER_TYPE;
 static gint o_count = 0;
+static gint o_decompose = FALSE;
+static gint o_follow_up = FALSE;
+static gint o_follow_up_timeout_ms = 1000;
 static gint o_ptp_mode = FALSE;
+static gchar *o_pcapng = NULL;
+static gchar *o_replay = NULL;
+static gint o_replay_realtime = FALSE;
 static gint o_no_hw_ts = FALSE;
 static gint o_rx_filter = HWTSTAMP_FILTER_ALL;
+static gchar *o_shm_name = NULL;
+static gchar *o_socket = NULL;
+static gint o_socket_queue_len = STREAM_DEFAULT_QUEUE_LEN;
 static gint o_verbose = 0;
 static gint o_version = 0;
 static gint count = 0;
 
+static gint o_rcvbuf = 0;
+static gint o_expected_rate = 0;
+static gint o_socket_stats_interval = 0;
+static gint o_self_stats_interval = 0;
+static gint o_summary_interval = 0;
+
+static gchar *o_event_file = NULL;
+static gint o_event_pre = RECORDER_DEFAULT_PRE;
+static gint o_event_post = RECORDER_DEFAULT_POST;
+static gint o_event_holdoff_ms = RECORDER_DEFAULT_HOLDOFF_MS;
+static gint o_trigger_latency_usec = 0;
+static gint o_trigger_jitter_usec = 0;
+static gint o_trigger_loss = 0;
+static gint o_trace_marker = FALSE;
+static gint o_breaktrace_usec = 0;
+static gint o_clock_estimate = FALSE;
+static gint o_clock_window_ms = 1000;
+static gint o_clock_correct = FALSE;
+static gint o_reflect = FALSE;
+
 static gboolean do_shutdown = FALSE;
 
+static int capture_fd = -1;
+static struct socket_stats socket_stats;
+static gboolean have_rxq_ovfl = FALSE;
+static guint32 last_rxq_ovfl = 0;
+static guint64 local_drops_pending = 0;
+
+static struct stream_server *stream_server = NULL;
+static struct stats_shm *stats_shm = NULL;
+static struct pcapng_file *pcapng = NULL;
+static struct recorder *recorder = NULL;
+static struct ftrace *ftrace = NULL;
+
+static struct rx_summary summaries[MAX_STREAM_ID];
+static struct skew skews[MAX_STREAM_ID];
+static gint64 last_summary;
+
+/* latency of the last packet of each stream for the jitter trigger */
+static struct {
+    gboolean valid;
+    gint64 latency;
+} last_latency[MAX_STREAM_ID];
+
+static struct histogram stage_hists[MAX_STAGE];
+static guint64 stage_missing[MAX_STAGE];
+
+/* self-instrumentation marks of the current packet in CLOCK_MONOTONIC nsec */
+static struct {
+    gint64 recv;
+    gint64 analyzed;
+    gint64 record;
+    gint64 write;
+} self_mark;
+static struct self_stats self_stats;
+static struct rusage self_last_rusage;
+static gint64 self_last_report;
+
+static struct ether_addr own_eth_addr;
+static struct {
+    guint64 reflected;
+    guint64 ignored;
+    guint64 send_errors;
+} reflect_stats;
+
 static void get_hw_timestamps(struct msghdr *msg, struct timespec *ts1, struct timespec *ts2)
 {
     struct cmsghdr *cmsg;
@@ -104,6 +187,8 @@ static void get_hw_timestamps(struct msghdr *msg, struct timespec *ts1, struct t
             memcpy(ts1, &scm_ts->ts[0], sizeof(struct timespec));
             memcpy(ts2, &scm_ts->ts[2], sizeof(struct timespec));
             break;
+        case SO_RXQ_OVFL:
+            break;
         default:
             printf("cmsg_type=%d", cmsg->cmsg_type);
             /* Ignore other cmsg options */
@@ -112,19 +197,118 @@ static void get_hw_timestamps(struct msghdr *msg, struct timespec *ts1, struct t
     }
 }
 
+/*
+ * The SO_RXQ_OVFL counter is the number of packets dropped by the socket
+ * until the packet was queued. The kernel omits it as long as it is 0.
+ */
+static gboolean get_rxq_ovfl(struct msghdr *msg, guint32 *ovfl)
+{
+    struct cmsghdr *cmsg;
+
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET
+                && cmsg->cmsg_type == SO_RXQ_OVFL) {
+            memcpy(ovfl, CMSG_DATA(cmsg), sizeof(*ovfl));
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/* returns the number of drops since the last call */
+static guint64 read_packet_statistics(int fd)
+{
+    struct tpacket_stats_v3 st;
+    socklen_t len = sizeof(st);
+
+    /* the kernel resets the counters on every read */
+    memset(&st, 0, sizeof(st));
+    if (getsockopt(fd, SOL_PACKET, PACKET_STATISTICS, &st, &len) < 0) {
+        perror("getsockopt(PACKET_STATISTICS)");
+        return 0;
+    }
+
+    socket_stats.packets += st.tp_packets;
+    socket_stats.drops += st.tp_drops;
+    socket_stats.freeze_q_cnt += st.tp_freeze_q_cnt;
+
+    return st.tp_drops;
+}
+
+/*
+ * Without SO_RXQ_OVFL the drops read from PACKET_STATISTICS are kept for the
+ * attribution of the next sequence gap.
+ */
+static void update_packet_statistics(int fd)
+{
+    guint64 drops = read_packet_statistics(fd);
+
+    if (!have_rxq_ovfl) {
+        local_drops_pending += drops;
+    }
+}
+
+/* collect the drops of the capture socket which are not yet attributed */
+static void account_local_drops(struct msghdr *msg)
+{
+    guint32 ovfl;
+
+    if (have_rxq_ovfl && get_rxq_ovfl(msg, &ovfl)) {
+        local_drops_pending += (guint32)(ovfl - last_rxq_ovfl);
+        last_rxq_ovfl = ovfl;
+    }
+}
+
+/*
+ * A sequence gap is caused by the sender as far as it reports missed
+ * intervals, then by the local receive buffer as far as the socket has
+ * dropped packets, the rest is lost in the network.
+ */
+static void attribute_drops(struct result *result)
+{
+    guint64 local;
+    gint sender = 0;
+
+    result->sender_overrun = 0;
+    result->local_overflow = 0;
+    result->network_loss = 0;
+
+    if (result->dropped <= 0) {
+        return;
+    }
+
+    if (result->tp) {
+        sender = MIN((gint)TP_OVERRUNS(result->tp->flags), result->dropped);
+    }
+
+    if (!have_rxq_ovfl && capture_fd >= 0) {
+        update_packet_statistics(capture_fd);
+    }
+
+    local = MIN(local_drops_pending, (guint64)(result->dropped - sender));
+    local_drops_pending -= local;
+
+    result->sender_overrun = sender;
+    result->local_overflow = local;
+    result->network_loss = result->dropped - sender - local;
+}
+
 static gboolean is_broadcast_addr(guint8 *addr)
 {
     return !memcmp(addr, "\xff\xff\xff\xff\xff\xff", ETH_ALEN);
 }
 
+#define RX_BUF_SIZE 2048
+
 static struct msghdr *receive_msg(int fd, struct ether_addr *myaddr)
 {
     static struct msghdr msg;
     static struct iovec iov;
-    static unsigned char buf[2048];
+    static unsigned char buf[RX_BUF_SIZE];
     static char cbuf[1024];
     struct sockaddr_in host_address;
-    struct ether_testpacket *tp = (void*)buf;
+    struct ether_header *hdr = (void*)buf;
     int n;
 
     /* recvmsg header structure */
@@ -139,16 +323,17 @@ static struct msghdr *receive_msg(int fd, struct ether_addr *myaddr)
 
     /* block for message */
     n = recvmsg(fd, &msg, 0);
-    if ( n == -1 && errno == EAGAIN ) {
-        return 0;
+    if (n == -1) {
+        return NULL;
     }
+    iov.iov_len = n;
 
     if (myaddr != NULL) {
         /* filter for own ether packets */
-        if (is_broadcast_addr(tp->hdr.ether_dhost)) {
+        if (is_broadcast_addr(hdr->ether_dhost)) {
             return &msg;
         }
-        if (memcmp(myaddr->ether_addr_octet, tp->hdr.ether_dhost, ETH_ALEN)) {
+        if (memcmp(myaddr->ether_addr_octet, hdr->ether_dhost, ETH_ALEN)) {
             return NULL;
         }
     }
@@ -162,7 +347,8 @@ static int check_sequence_num(struct result *result)
         result->dropped = 0;
         result->seq_error = 0;
     } else {
-        result->dropped = MAX((gint)result->tp->seq - (gint)result->last_tp->seq - 1, 0);
+        gint64 gap = (gint64)(result->tp->seq - result->last_tp->seq) - 1;
+        result->dropped = CLAMP(gap, 0, G_MAXINT);
         result->seq_error = result->tp->seq <= result->last_tp->seq;
     }
 
@@ -170,16 +356,11 @@ static int check_sequence_num(struct result *result)
 }
 
 static int handle_test_packet(struct msghdr *msg,
-        struct result *result)
+        struct ether_testpacket *tp, struct result *result,
+        struct timespec *prog_ts)
 {
-    struct ether_testpacket *tp = (void*)msg->msg_iov->iov_base;
     int rc;
 
-    /* ignore future packet versions */
-    if (tp->version != 1) {
-        return 0;
-    }
-
     /* remember test packet */
     g_free(result->last_tp);
     g_free(result->last_rx_tss);
@@ -188,15 +369,25 @@ static int handle_test_packet(struct msghdr *msg,
     result->tp = g_memdup(tp, sizeof(*tp));
     result->rx_tss = g_new0(struct timespec, MAX_TS_RX);
 
-    /* get rx timestamp */
-    clock_gettime(CLOCK_REALTIME, &result->rx_tss[TS_PROG_RECV]);
+    result->rx_tss[TS_PROG_RECV] = *prog_ts;
 
     get_hw_timestamps(msg,
             &result->rx_tss[TS_KERNEL_SW_RX],
             &result->rx_tss[TS_KERNEL_HW_RX]);
+    NL_PROBE5(rx_test_packet, tp->stream_id, tp->seq,
+            NL_PROBE_NS(result->rx_tss[TS_KERNEL_HW_RX]),
+            NL_PROBE_NS(result->rx_tss[TS_KERNEL_SW_RX]),
+            NL_PROBE_NS(result->rx_tss[TS_PROG_RECV]));
+
+    account_local_drops(msg);
 
     /* calc dropped count and sequence error */
     rc = check_sequence_num(result);
+    attribute_drops(result);
+    if (rc) {
+        NL_PROBE4(rx_seq_error, tp->stream_id, tp->seq, result->dropped,
+                result->seq_error);
+    }
 
     /* if there was an error discard last_tp */
     if (rc) {
@@ -209,7 +400,557 @@ static int handle_test_packet(struct msghdr *msg,
     return 0;
 }
 
-static int handle_msg(struct msghdr *msg)
+/*
+ * The latency is taken from RX hardware (or program) timestamp to the TX
+ * program timestamp, in small packet mode only the interval start is
+ * available. Returns FALSE if the packet carries no TX timestamp.
+ */
+static gboolean test_packet_latency(struct ether_testpacket *tp,
+        struct timespec *rx_tss, gint64 *tx_ns, gint64 *latency)
+{
+    struct timespec *rx_ts = &rx_tss[TS_KERNEL_HW_RX];
+    struct timespec tx_ts;
+
+    if (rx_ts->tv_sec == 0 && rx_ts->tv_nsec == 0) {
+        rx_ts = &rx_tss[TS_PROG_RECV];
+    }
+
+    /* copy the timestamp to avoid unaligned pointer compiler errors */
+    if (tp->flags & TP_FLAG_SMALL_MODE) {
+        memcpy(&tx_ts, &tp->timestamps[TS_T0], sizeof(tx_ts));
+    } else {
+        memcpy(&tx_ts, &tp->timestamps[TS_PROG_SEND], sizeof(tx_ts));
+    }
+    *tx_ns = (gint64)tx_ts.tv_sec * 1000000000 + tx_ts.tv_nsec;
+    *latency = timespec_diff_ns(&tx_ts, rx_ts);
+
+    return tx_ts.tv_sec || tx_ts.tv_nsec;
+}
+
+/* publish the counters of a stream in the shared memory segment */
+static void update_shm_stats(struct stats_stream *s, struct result *result,
+        const gint64 *latency)
+{
+    stats_write_begin(s);
+    s->active = 1;
+    s->packets++;
+    s->dropped += result->dropped;
+    s->seq_errors += result->seq_error;
+    if (latency) {
+        s->latency_last = *latency;
+        histogram_add(&s->latency, *latency);
+    }
+    stats_write_end(s);
+}
+
+static void update_summary(struct rx_summary *summary,
+        struct result *result, const gint64 *latency)
+{
+    summary->packets++;
+    summary->dropped += result->dropped;
+    summary->seq_errors += result->seq_error;
+    if (latency) {
+        histogram_add(&summary->latency, *latency);
+    }
+}
+
+static gint64 self_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (gint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void self_begin(void)
+{
+    self_mark.recv = self_now();
+    self_mark.analyzed = 0;
+    self_mark.record = 0;
+    self_mark.write = 0;
+}
+
+static void self_analyzed(void)
+{
+    if (o_self_stats_interval) {
+        self_mark.analyzed = self_now();
+    }
+}
+
+/*
+ * Everything after the analysis which is not writing is accounted as
+ * formatting, i.e. building and serializing the records. The pcapng write
+ * happens before the analysis and is only accounted as writing.
+ */
+static void self_end(void)
+{
+    gint64 done = self_now();
+
+    if (self_mark.analyzed == 0) {
+        self_mark.analyzed = done - self_mark.write;
+    }
+
+    histogram_add(&self_stats.stages[SELF_ANALYSIS],
+            self_mark.analyzed - self_mark.recv - self_mark.record);
+    histogram_add(&self_stats.stages[SELF_FORMAT],
+            done - self_mark.analyzed - self_mark.write);
+    histogram_add(&self_stats.stages[SELF_WRITE],
+            self_mark.record + self_mark.write);
+    histogram_add(&self_stats.stages[SELF_TOTAL], done - self_mark.recv);
+    self_stats.packets++;
+}
+
+static gint64 timeval_diff_usec(struct timeval *a, struct timeval *b)
+{
+    return ((gint64)b->tv_sec - a->tv_sec) * 1000000
+        + (b->tv_usec - a->tv_usec);
+}
+
+static void self_reset(void)
+{
+    int i;
+
+    getrusage(RUSAGE_SELF, &self_last_rusage);
+    self_last_report = self_now();
+
+    self_stats.packets = 0;
+    for (i = 0; i < MAX_SELF_STAGE; i++) {
+        histogram_init(&self_stats.stages[i]);
+    }
+}
+
+/* write a record to stdout and to all socket subscribers */
+static void output_record(const char *s)
+{
+    gint64 start = 0;
+
+    if (o_self_stats_interval) {
+        start = self_now();
+    }
+    printf("%s\n", s);
+    fflush(stdout);
+    if (stream_server) {
+        stream_server_publish(stream_server, s);
+    }
+    if (o_self_stats_interval) {
+        self_mark.write += self_now() - start;
+    }
+}
+
+static void output_json(json_t *j)
+{
+    char *s = json_dumps(j, JSON_COMPACT);
+
+    if (s) {
+        output_record(s);
+        free(s);
+    }
+}
+
+/*
+ * Write a record of a stream. The event recorder keeps all records of the
+ * stream, per packet records are not written in summary mode.
+ */
+static void output_stream_json(int stream_id, json_t *j, gboolean per_packet)
+{
+    char *s = json_dumps(j, JSON_COMPACT);
+
+    if (s) {
+        if (recorder) {
+            recorder_add(recorder, stream_id, s);
+        }
+        if (!per_packet || !o_summary_interval) {
+            output_record(s);
+        }
+        free(s);
+    }
+}
+
+/* per packet records are only built if someone takes them */
+static gboolean want_packet_records(void)
+{
+    return recorder || !o_summary_interval;
+}
+
+static void trigger_event(int stream_id, const char *reason,
+        struct result *result, gint64 value, gint64 threshold)
+{
+    struct rx_summary *summary = &summaries[stream_id];
+    struct timespec *rx_ts = &result->rx_tss[TS_PROG_RECV];
+    guint64 events, suppressed;
+    json_t *info;
+
+    recorder_stream_stats(recorder, stream_id, &events, &suppressed);
+    summary->events -= events;
+    summary->suppressed -= suppressed;
+
+    /* the holdoff is measured in receive time to replay the same events */
+    info = json_event_info(reason, result->tp, rx_ts, value, threshold);
+    recorder_trigger(recorder, stream_id,
+            (gint64)rx_ts->tv_sec * 1000000000 + rx_ts->tv_nsec, info);
+
+    recorder_stream_stats(recorder, stream_id, &events, &suppressed);
+    summary->events += events;
+    summary->suppressed += suppressed;
+}
+
+/* start an event if the packet violates one of the thresholds */
+static void check_triggers(int stream_id, struct result *result,
+        const gint64 *latency)
+{
+    gint64 latency_ns = (gint64)o_trigger_latency_usec * 1000;
+    gint64 jitter_ns = (gint64)o_trigger_jitter_usec * 1000;
+
+    if (o_trigger_loss && result->dropped >= o_trigger_loss) {
+        trigger_event(stream_id, "loss", result, result->dropped,
+                o_trigger_loss);
+    }
+
+    if (latency == NULL) {
+        return;
+    }
+
+    if (latency_ns && *latency >= latency_ns) {
+        trigger_event(stream_id, "latency", result, *latency, latency_ns);
+    }
+
+    if (jitter_ns && last_latency[stream_id].valid) {
+        gint64 jitter = ABS(*latency - last_latency[stream_id].latency);
+        if (jitter >= jitter_ns) {
+            trigger_event(stream_id, "jitter", result, jitter, jitter_ns);
+        }
+    }
+
+    last_latency[stream_id].valid = TRUE;
+    last_latency[stream_id].latency = *latency;
+}
+
+/*
+ * Annotate the reception of a test packet in the ftrace buffer and stop
+ * tracing if its latency exceeds the --breaktrace bound.
+ */
+static void trace_test_packet(int stream_id, struct result *result,
+        const gint64 *latency)
+{
+    gint64 threshold_ns = (gint64)o_breaktrace_usec * 1000;
+    json_t *j;
+
+    if (o_trace_marker) {
+        ftrace_mark(ftrace, "nl-rx stream=%d seq=%" G_GUINT64_FORMAT
+                " stage=received latency-ns=%" G_GINT64_FORMAT, stream_id,
+                result->tp->seq, latency ? *latency : 0);
+    }
+
+    if (threshold_ns && latency && *latency > threshold_ns
+            && ftrace_break(ftrace, "nl-rx breaktrace stream=%d seq=%"
+                G_GUINT64_FORMAT " latency-ns=%" G_GINT64_FORMAT
+                " threshold-ns=%" G_GINT64_FORMAT, stream_id,
+                result->tp->seq, *latency, threshold_ns)) {
+        j = json_breaktrace(result->tp, *latency, threshold_ns);
+        output_json(j);
+        json_decref(j);
+    }
+}
+
+/* report the clock estimate of a stream after each window */
+static void update_clock_estimate(int stream_id, gint64 tx_ns,
+        gint64 latency)
+{
+    struct skew *s = &skews[stream_id];
+    json_t *j;
+
+    if (skew_add(s, tx_ns, latency) && skew_valid(s)) {
+        j = json_clock(stream_id, s);
+        output_stream_json(stream_id, j, FALSE);
+        json_decref(j);
+    }
+}
+
+/* the latency less the change of the clock offset since the first window */
+static void add_corrected_latency(json_t *j, struct ether_testpacket *tp,
+        struct timespec *rx_tss)
+{
+    struct skew *s = &skews[tp->stream_id];
+    gint64 tx_ns, latency, corrected;
+
+    if (!test_packet_latency(tp, rx_tss, &tx_ns, &latency)) {
+        return;
+    }
+
+    corrected = latency - skew_correction(s, tx_ns);
+    json_add_latency(j, latency, skew_valid(s) ? &corrected : NULL);
+}
+
+static void report_summaries(void)
+{
+    gint64 now = g_get_monotonic_time();
+    json_t *j;
+    int i;
+
+    for (i = 0; i < MAX_STREAM_ID; i++) {
+        struct rx_summary *summary = &summaries[i];
+
+        /* streams which have not been seen yet */
+        if (results[i].tp == NULL) {
+            continue;
+        }
+
+        summary->interval_ns = (now - last_summary) * 1000;
+        j = json_summary(i, summary);
+        output_json(j);
+        json_decref(j);
+
+        memset(summary, 0, sizeof(*summary));
+        histogram_init(&summary->latency);
+    }
+
+    last_summary = now;
+}
+
+static void report_self_stats(void)
+{
+    struct rusage usage;
+    json_t *j;
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    self_stats.interval_ns = self_now() - self_last_report;
+    self_stats.utime_usec = timeval_diff_usec(&self_last_rusage.ru_utime,
+            &usage.ru_utime);
+    self_stats.stime_usec = timeval_diff_usec(&self_last_rusage.ru_stime,
+            &usage.ru_stime);
+    self_stats.max_rss_kb = usage.ru_maxrss;
+
+    /* the report itself is accounted to the next interval */
+    j = json_self_stats(&self_stats);
+    output_json(j);
+    json_decref(j);
+
+    self_reset();
+}
+
+static void report_socket_stats(int fd)
+{
+    json_t *j;
+
+    update_packet_statistics(fd);
+
+    j = json_socket_stats(&socket_stats);
+    output_json(j);
+    json_decref(j);
+}
+
+static void decompose_stage(struct decomposition *d, int stage,
+        struct timespec *from, struct timespec *to)
+{
+    d->valid[stage] = (from->tv_sec || from->tv_nsec)
+            && (to->tv_sec || to->tv_nsec);
+    d->delta[stage] = d->valid[stage] ? timespec_diff_ns(from, to) : 0;
+}
+
+/*
+ * Split the latency of a test packet into its stages. The kernel TX
+ * timestamps are taken from the following test packet or the follow-up
+ * frame, the hardware TX timestamp is only carried by follow-up frames.
+ */
+static void decompose_latency(struct ether_testpacket *tp,
+        struct ether_testpacket *fu, struct timespec *rx_tss,
+        struct decomposition *d)
+{
+    struct timespec tx[TS_MAX_NUM];
+
+    memset(tx, 0, sizeof(tx));
+
+    /* copy the timestamps to avoid unaligned pointer compiler errors */
+    memcpy(&tx[TS_T0], &tp->timestamps[TS_T0], sizeof(tx[0]));
+    if (!(tp->flags & TP_FLAG_SMALL_MODE)) {
+        memcpy(&tx[TS_WAKEUP], &tp->timestamps[TS_WAKEUP], sizeof(tx[0]));
+        memcpy(&tx[TS_PROG_SEND], &tp->timestamps[TS_PROG_SEND],
+                sizeof(tx[0]));
+        memcpy(&tx[TS_LAST_KERNEL_SCHED],
+                &fu->timestamps[TS_LAST_KERNEL_SCHED], sizeof(tx[0]));
+        memcpy(&tx[TS_LAST_KERNEL_SW_TX],
+                &fu->timestamps[TS_LAST_KERNEL_SW_TX], sizeof(tx[0]));
+    }
+    if (fu->flags & TP_FLAG_FOLLOW_UP) {
+        memcpy(&tx[TS_LAST_KERNEL_HW_TX],
+                &fu->timestamps[TS_LAST_KERNEL_HW_TX], sizeof(tx[0]));
+    }
+
+    d->stream_id = tp->stream_id;
+    d->seq = tp->seq;
+
+    decompose_stage(d, STAGE_WAKEUP_T0, &tx[TS_T0], &tx[TS_WAKEUP]);
+    decompose_stage(d, STAGE_PROGRAM_WAKEUP,
+            &tx[TS_WAKEUP], &tx[TS_PROG_SEND]);
+    decompose_stage(d, STAGE_NETSCHED_PROGRAM,
+            &tx[TS_PROG_SEND], &tx[TS_LAST_KERNEL_SCHED]);
+    decompose_stage(d, STAGE_DRIVER_NETSCHED,
+            &tx[TS_LAST_KERNEL_SCHED], &tx[TS_LAST_KERNEL_SW_TX]);
+    decompose_stage(d, STAGE_WIRE,
+            &tx[TS_LAST_KERNEL_HW_TX], &rx_tss[TS_KERNEL_HW_RX]);
+    decompose_stage(d, STAGE_RX_SW_HW,
+            &rx_tss[TS_KERNEL_HW_RX], &rx_tss[TS_KERNEL_SW_RX]);
+    decompose_stage(d, STAGE_RX_PROGRAM_SW,
+            &rx_tss[TS_KERNEL_SW_RX], &rx_tss[TS_PROG_RECV]);
+}
+
+static void emit_decomposition(struct ether_testpacket *tp,
+        struct ether_testpacket *fu, struct timespec *rx_tss)
+{
+    struct decomposition d;
+    json_t *j;
+    int i;
+
+    decompose_latency(tp, fu, rx_tss, &d);
+
+    for (i = 0; i < MAX_STAGE; i++) {
+        if (d.valid[i]) {
+            histogram_add(&stage_hists[i], d.delta[i]);
+        } else {
+            stage_missing[i]++;
+        }
+    }
+
+    if (want_packet_records()) {
+        j = json_decomposition(&d);
+        output_stream_json(d.stream_id, j, TRUE);
+        json_decref(j);
+    }
+}
+
+static void report_decomposition_summary(void)
+{
+    json_t *j;
+
+    j = json_decomposition_summary(stage_hists, stage_missing);
+    output_json(j);
+    json_decref(j);
+}
+
+static void emit_test_packet(struct ether_testpacket *tp,
+        struct ether_testpacket *fu, struct timespec *rx_tss)
+{
+    json_t *j;
+
+    if (want_packet_records()) {
+        j = json_test_packet(tp, fu, rx_tss);
+        if (o_clock_correct) {
+            add_corrected_latency(j, tp, rx_tss);
+        }
+        output_stream_json(tp->stream_id, j, TRUE);
+        json_decref(j);
+    }
+    NL_PROBE3(rx_output, tp->stream_id, tp->seq,
+            NL_PROBE_NS(rx_tss[TS_PROG_RECV]));
+
+    if (o_decompose) {
+        emit_decomposition(tp, fu, rx_tss);
+    }
+
+    if (o_count && ++count >= o_count) {
+        do_shutdown = TRUE;
+    }
+}
+
+static void pending_flush(struct pending_entry *entry)
+{
+    /* a follow-up without test packet carries no sample */
+    if (entry->have_tp) {
+        if (entry->have_fu) {
+            emit_test_packet(&entry->tp, &entry->fu, entry->rx_tss);
+        } else {
+            struct ether_testpacket fu_dummy;
+            memset(&fu_dummy, 0, sizeof(fu_dummy));
+            emit_test_packet(&entry->tp, &fu_dummy, entry->rx_tss);
+        }
+
+        if (entry->tp.flags & TP_FLAG_END_OF_STREAM) {
+            do_shutdown = TRUE;
+        }
+    }
+
+    entry->have_tp = FALSE;
+    entry->have_fu = FALSE;
+}
+
+static struct pending_entry *pending_get(struct result *result, guint64 seq)
+{
+    struct pending_entry *entry;
+
+    if (result->pending == NULL) {
+        result->pending = g_new0(struct pending_entry, RX_PENDING_WINDOW);
+    }
+
+    entry = &result->pending[seq % RX_PENDING_WINDOW];
+
+    /* the slot is still occupied by an older sequence number */
+    if ((entry->have_tp || entry->have_fu) && entry->seq != seq) {
+        pending_flush(entry);
+    }
+
+    if (!entry->have_tp && !entry->have_fu) {
+        entry->seq = seq;
+        entry->expires = g_get_monotonic_time()
+                + (gint64)o_follow_up_timeout_ms * 1000;
+    }
+
+    return entry;
+}
+
+static void pending_complete(struct pending_entry *entry)
+{
+    if (entry->have_tp && entry->have_fu) {
+        pending_flush(entry);
+    }
+}
+
+static void pending_add_test_packet(struct result *result)
+{
+    struct pending_entry *entry = pending_get(result, result->tp->seq);
+
+    memcpy(&entry->tp, result->tp, sizeof(entry->tp));
+    memcpy(entry->rx_tss, result->rx_tss, sizeof(entry->rx_tss));
+    entry->have_tp = TRUE;
+
+    pending_complete(entry);
+}
+
+static void pending_add_follow_up(struct result *result,
+        struct ether_testpacket *fu)
+{
+    struct pending_entry *entry = pending_get(result, fu->seq);
+
+    memcpy(&entry->fu, fu, sizeof(entry->fu));
+    entry->have_fu = TRUE;
+
+    pending_complete(entry);
+}
+
+static void pending_expire(gint64 now)
+{
+    int i, n;
+
+    for (i = 0; i < MAX_STREAM_ID; i++) {
+        struct pending_entry *pending = results[i].pending;
+        if (pending == NULL) {
+            continue;
+        }
+
+        for (n = 0; n < RX_PENDING_WINDOW; n++) {
+            struct pending_entry *entry = &pending[n];
+            if ((entry->have_tp || entry->have_fu) && entry->expires <= now) {
+                pending_flush(entry);
+            }
+        }
+    }
+}
+
+/*
+ * Analyze a received frame. The program receive timestamp is taken by the
+ * caller, the kernel timestamps are read from the control messages.
+ */
+static int handle_msg(struct msghdr *msg, struct timespec *prog_ts)
 {
     struct ether_header *hdr = msg->msg_iov->iov_base;
     guint16 ethertype = ntohs(hdr->ether_type);
@@ -219,31 +960,84 @@ static int handle_msg(struct msghdr *msg)
     case TP_ETHER_TYPE: {
         struct result *result;
         json_t *j;
-        struct ether_testpacket *tp = (void*)hdr;
-        int stream_id = tp->stream_id;
-        result = &results[stream_id];
+        struct ether_testpacket decoded;
+        struct ether_testpacket *tp = &decoded;
+        gint64 tx_ns;
+        gint64 latency;
+        gboolean have_latency;
+        int stream_id;
+
+        /* ignore future packet versions */
+        if (tp_decode(hdr, msg->msg_iov->iov_len, tp)) {
+            return 0;
+        }
 
         /* ignore packets with large stream ids */
-        if (stream_id > MAX_STREAM_ID) {
+        stream_id = tp->stream_id;
+        if (stream_id >= MAX_STREAM_ID) {
+            return 0;
+        }
+        result = &results[stream_id];
+
+        if (tp->flags & TP_FLAG_FOLLOW_UP) {
+            if (o_follow_up) {
+                pending_add_follow_up(result, tp);
+            }
+            return 0;
+        }
+
+        if (tp->flags & TP_FLAG_OVERRUN_MARKER) {
+            j = json_overrun(tp);
+            output_stream_json(stream_id, j, FALSE);
+            json_decref(j);
             return 0;
         }
 
-        handle_test_packet(msg, result);
+        handle_test_packet(msg, tp, result, prog_ts);
+        have_latency = test_packet_latency(result->tp, result->rx_tss,
+                &tx_ns, &latency);
+
+        if (stats_shm) {
+            update_shm_stats(&stats_shm->streams[stream_id], result,
+                    have_latency ? &latency : NULL);
+        }
+
+        if (o_summary_interval) {
+            update_summary(&summaries[stream_id], result,
+                    have_latency ? &latency : NULL);
+        }
+
+        if (recorder) {
+            check_triggers(stream_id, result, have_latency ? &latency : NULL);
+        }
+
+        if (ftrace) {
+            trace_test_packet(stream_id, result,
+                    have_latency ? &latency : NULL);
+        }
+
+        if (o_clock_estimate && have_latency) {
+            update_clock_estimate(stream_id, tx_ns, latency);
+        }
+
+        self_analyzed();
 
         if (result->dropped || result->seq_error) {
-            j = json_error(result);
-            dump_json_stdout(j);
+            j = json_error(stream_id, result);
+            output_stream_json(stream_id, j, FALSE);
             json_decref(j);
         }
 
+        /* records are emitted once the follow-up frame has been joined */
+        if (o_follow_up) {
+            pending_add_test_packet(result);
+            return 0;
+        }
+
         /* we have to wait for at least two packets */
         if (result->last_tp) {
-            j = json_test_packet(result->last_tp, result->tp, result->last_rx_tss);
-            dump_json_stdout(j);
-            json_decref(j);
-
-            if (o_count && ++count >= o_count) {
-                do_shutdown = TRUE;
+            emit_test_packet(result->last_tp, result->tp, result->last_rx_tss);
+            if (do_shutdown) {
                 return 0;
             }
         }
@@ -251,10 +1045,8 @@ static int handle_msg(struct msghdr *msg)
         /* or we've received the last packet */
         if (result->tp->flags & TP_FLAG_END_OF_STREAM) {
             struct ether_testpacket *tp_dummy = g_new0(struct ether_testpacket, 1);
-            j = json_test_packet(result->tp, tp_dummy, result->rx_tss);
+            emit_test_packet(result->tp, tp_dummy, result->rx_tss);
             g_free(tp_dummy);
-            dump_json_stdout(j);
-            json_decref(j);
 
             do_shutdown = TRUE;
             return 0;
@@ -270,6 +1062,43 @@ static int handle_msg(struct msghdr *msg)
     return 0;
 }
 
+/*
+ * Send a test frame straight back to its sender with the receive and send
+ * time of the reflector. The frame is turned around in the receive buffer,
+ * there is no analysis and no record per packet. Both times are taken from
+ * CLOCK_REALTIME, the kernel software timestamp or the program receive
+ * time, so that their difference does not depend on the PHC.
+ */
+static void reflect_msg(int fd, struct msghdr *msg, struct timespec *prog_ts)
+{
+    struct timespec rx_ts;
+    struct timespec hw_ts;
+    struct timespec tx_ts;
+    void *buf = msg->msg_iov->iov_base;
+    gssize len;
+
+    get_hw_timestamps(msg, &rx_ts, &hw_ts);
+    if (rx_ts.tv_sec == 0 && rx_ts.tv_nsec == 0) {
+        rx_ts = *prog_ts;
+    }
+
+    len = tp_reflect(buf, msg->msg_iov->iov_len, RX_BUF_SIZE,
+            own_eth_addr.ether_addr_octet, &rx_ts);
+    if (len < 0) {
+        reflect_stats.ignored++;
+        return;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &tx_ts);
+    tp_reflect_set_tx(buf, &tx_ts);
+    if (send(fd, buf, len, 0) < 0) {
+        reflect_stats.send_errors++;
+        return;
+    }
+    NL_PROBE3(rx_reflect, len, NL_PROBE_NS(rx_ts), NL_PROBE_NS(tx_ts));
+    reflect_stats.reflected++;
+}
+
 static int get_own_eth_address(int fd, gchar *ifname, struct ether_addr *src_eth_addr)
 {
     struct ifreq ifopts;
@@ -313,6 +1142,7 @@ static int setsockopt_rx_timestamping(int fd)
     int opt;
 
     opt = SOF_TIMESTAMPING_RX_HARDWARE
+          | SOF_TIMESTAMPING_RX_SOFTWARE
           | SOF_TIMESTAMPING_RAW_HARDWARE
           | SOF_TIMESTAMPING_SYS_HARDWARE
           | SOF_TIMESTAMPING_SOFTWARE;
@@ -380,6 +1210,83 @@ static int open_capture_interface(gchar *ifname)
     return fd;
 }
 
+static int setsockopt_rcvtimeo(int fd, gint timeout_ms)
+{
+    int rc;
+    struct timeval tv;
+
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+    rc = setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (rc == -1) {
+        perror("setsockopt(SO_RCVTIMEO)");
+        return -1;
+    }
+
+    return rc;
+}
+
+static int setsockopt_rxq_ovfl(int fd)
+{
+    int rc;
+    int opt = 1;
+
+    rc = setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &opt, sizeof(opt));
+    if (rc == -1) {
+        perror("setsockopt(SO_RXQ_OVFL)");
+        return -1;
+    }
+
+    return rc;
+}
+
+/*
+ * The receive buffer should hold the packets of RCVBUF_HEADROOM_MS at the
+ * expected rate. A packet occupies its skb truesize in the buffer, which is
+ * about RCVBUF_BYTES_PER_PACKET for a full sized frame.
+ */
+#define RCVBUF_BYTES_PER_PACKET 2304
+#define RCVBUF_HEADROOM_MS 500
+#define RCVBUF_MIN (256 * 1024)
+
+static int rcvbuf_for_rate(gint rate)
+{
+    gint64 size = (gint64)rate * RCVBUF_BYTES_PER_PACKET
+            * RCVBUF_HEADROOM_MS / 1000;
+
+    return CLAMP(size, RCVBUF_MIN, G_MAXINT / 2);
+}
+
+static int setsockopt_rcvbuf(int fd, int size)
+{
+    int rc;
+    int actual;
+    socklen_t len = sizeof(actual);
+
+    /* SO_RCVBUFFORCE ignores rmem_max but needs CAP_NET_ADMIN */
+    rc = setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size));
+    if (rc == -1) {
+        rc = setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        if (rc == -1) {
+            perror("setsockopt(SO_RCVBUF)");
+            return -1;
+        }
+    }
+
+    /* the kernel doubles the value for its bookkeeping overhead */
+    if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &actual, &len) == 0) {
+        if (actual / 2 < size) {
+            fprintf(stderr, "receive buffer limited to %d bytes"
+                    " (requested %d)\n", actual / 2, size);
+        } else if (o_verbose) {
+            fprintf(stderr, "receive buffer is %d bytes\n", actual / 2);
+        }
+    }
+
+    return 0;
+}
+
 static int flush_socket(int fd)
 {
     int rc;
@@ -469,13 +1376,92 @@ static GOptionEntry entries[] = {
     { "count",    'c', 0, G_OPTION_ARG_INT,
             &o_count,
             "Receive packet count", "COUNT" },
+    { "decompose", 'D', 0, G_OPTION_ARG_NONE,
+            &o_decompose, "Report the latency of each stage and a summary"
+            " at exit", NULL },
+    { "socket",   's', 0, G_OPTION_ARG_STRING,
+            &o_socket, "Write packet results to socket"
+            " (unix:PATH or udp:[HOST:]PORT)", "ADDRESS" },
+    { "socket-queue", 0, 0, G_OPTION_ARG_INT,
+            &o_socket_queue_len, "Records queued per socket subscriber"
+            " (default is 1024)", "LEN" },
+    { "rcvbuf",   'b', 0, G_OPTION_ARG_INT,
+            &o_rcvbuf, "Set socket receive buffer size", "BYTES" },
+    { "rate",     'r', 0, G_OPTION_ARG_INT,
+            &o_expected_rate, "Size the socket receive buffer for the"
+            " expected packet rate", "PPS" },
+    { "socket-stats", 0, 0, G_OPTION_ARG_INT,
+            &o_socket_stats_interval, "Report socket statistics every"
+            " SEC seconds", "SEC" },
+    { "self-stats", 0, 0, G_OPTION_ARG_INT,
+            &o_self_stats_interval, "Report the processing overhead of"
+            " nl-rx every SEC seconds", "SEC" },
+    { "summary",  0, 0, G_OPTION_ARG_INT,
+            &o_summary_interval, "Write a summary of each stream every SEC"
+            " seconds instead of the per packet records", "SEC" },
+    { "event-file", 0, 0, G_OPTION_ARG_STRING,
+            &o_event_file, "Write the records around threshold violations"
+            " to FILE", "FILE" },
+    { "event-pre", 0, 0, G_OPTION_ARG_INT,
+            &o_event_pre, "Records of a stream kept before an event"
+            " (default is 100)", "N" },
+    { "event-post", 0, 0, G_OPTION_ARG_INT,
+            &o_event_post, "Records of a stream written after an event"
+            " (default is 100)", "N" },
+    { "event-holdoff", 0, 0, G_OPTION_ARG_INT,
+            &o_event_holdoff_ms, "Minimum time between two events of a"
+            " stream in msec (default is 1000)", "MSEC" },
+    { "trigger-latency", 0, 0, G_OPTION_ARG_INT,
+            &o_trigger_latency_usec, "Start an event if the latency"
+            " reaches USEC", "USEC" },
+    { "trigger-jitter", 0, 0, G_OPTION_ARG_INT,
+            &o_trigger_jitter_usec, "Start an event if the latency changes"
+            " by USEC between two packets", "USEC" },
+    { "trigger-loss", 0, 0, G_OPTION_ARG_INT,
+            &o_trigger_loss, "Start an event if N or more packets are lost"
+            " at once", "N" },
+    { "clock-estimate", 0, 0, G_OPTION_ARG_NONE,
+            &o_clock_estimate, "Estimate the clock offset and drift to each"
+            " sender", NULL },
+    { "clock-window", 0, 0, G_OPTION_ARG_INT,
+            &o_clock_window_ms, "Window of the clock estimate in msec"
+            " (default is 1000)", "MSEC" },
+    { "clock-correct", 0, 0, G_OPTION_ARG_NONE,
+            &o_clock_correct, "Add the latency corrected by the clock"
+            " estimate to the packet records", NULL },
+    { "trace-marker", 0, 0, G_OPTION_ARG_NONE,
+            &o_trace_marker, "Annotate each received test packet in the"
+            " ftrace buffer", NULL },
+    { "breaktrace", 0, 0, G_OPTION_ARG_INT,
+            &o_breaktrace_usec, "Stop ftrace once the latency exceeds USEC",
+            "USEC" },
+    { "reflect", 0, 0, G_OPTION_ARG_NONE,
+            &o_reflect, "Send each test packet back to its sender for"
+            " round trip measurements, see nl-tx --rtt", NULL },
+    { "shm",      'm', 0, G_OPTION_ARG_STRING,
+            &o_shm_name, "Publish live statistics in shared memory"
+            " segment NAME", "NAME" },
     { "ethertype", 'e', 0, G_OPTION_ARG_INT,
             &o_capture_ethertype, "Set ethertype to filter"
             " (Default is 0x0808, ETH_P_ALL is 0x3)", "TYPE" },
     { "rxfilter", 'f', 0, G_OPTION_ARG_CALLBACK,
             parse_rx_filter_cb, "Set HW rx filter", "FILTER" },
+    { "follow-up", 'F', 0, G_OPTION_ARG_NONE,
+            &o_follow_up, "Join test packets with their follow-up frames",
+            NULL },
+    { "follow-up-timeout", 'T', 0, G_OPTION_ARG_INT,
+            &o_follow_up_timeout_ms, "Timeout for missing follow-up frames"
+            " in msec (default is 1000)", "MSEC" },
     { "ptp", 'p', 0, G_OPTION_ARG_NONE,
             &o_ptp_mode, "Set HW rx filter to PTP packets", NULL },
+    { "write",    'w', 0, G_OPTION_ARG_STRING,
+            &o_pcapng, "Write received frames and their timestamps to"
+            " pcapng FILE", "FILE" },
+    { "replay",    0, 0, G_OPTION_ARG_STRING,
+            &o_replay, "Analyze the frames of pcapng FILE instead of"
+            " capturing", "FILE" },
+    { "replay-realtime", 0, 0, G_OPTION_ARG_NONE,
+            &o_replay_realtime, "Replay with the original timing", NULL },
     { "no-hw-ts", 'n', 0, G_OPTION_ARG_NONE,
             &o_no_hw_ts, "Do not read HW timestamps", NULL },
     { "version",   'V', 0, G_OPTION_ARG_NONE,
@@ -511,6 +1497,12 @@ static void signal_handler(int signal)
     switch (signal) {
     case SIGINT:
     case SIGTERM:
+        /* finish the main loop to report the summary, exit on repeat */
+        if ((o_decompose || o_summary_interval || o_event_file || o_reflect
+                    || o_follow_up) && !do_shutdown) {
+            do_shutdown = TRUE;
+            break;
+        }
         exit(1);
     break;
     case SIGUSR1:
@@ -525,27 +1517,43 @@ static void show_version(void)
     g_printf("%s\n", VERSION);
 }
 
-int real_main(int argc, char **argv)
+static void record_msg(struct msghdr *msg, struct timespec *prog_ts)
 {
-    int rc;
-    int fd;
-    struct ether_addr *src_eth_addr = NULL;
-    char *ifname = NULL;
-    sigset_t sigset;
+    struct timespec rx_tss[MAX_TS_RX];
 
-    parse_command_line_options(&argc, argv);
+    get_hw_timestamps(msg, &rx_tss[TS_KERNEL_SW_RX],
+            &rx_tss[TS_KERNEL_HW_RX]);
+    rx_tss[TS_PROG_RECV] = *prog_ts;
 
-    if (o_version) {
-        show_version();
-        return 0;
-    }
+    pcapng_write_packet(pcapng, msg->msg_iov->iov_base,
+            msg->msg_iov->iov_len, rx_tss);
+}
 
-    if (argc < 2) {
-        usage();
-        return -1;
+/* record and handle a received message, timing it with --self-stats */
+static void process_msg(struct msghdr *msg, struct timespec *prog_ts)
+{
+    gint64 start;
+
+    if (o_self_stats_interval) {
+        self_begin();
+    }
+    if (pcapng && o_self_stats_interval) {
+        start = self_now();
+        record_msg(msg, prog_ts);
+        self_mark.record = self_now() - start;
+    } else if (pcapng) {
+        record_msg(msg, prog_ts);
     }
+    handle_msg(msg, prog_ts);
+    if (o_self_stats_interval) {
+        self_end();
+    }
+}
 
-    ifname = argv[1];
+static int open_live_capture(char *ifname)
+{
+    int rc;
+    int fd;
 
     if (o_ptp_mode) {
         o_capture_ethertype = ETH_P_1588;
@@ -559,8 +1567,7 @@ int real_main(int argc, char **argv)
     }
 
     if (o_ptp_mode == FALSE) {
-        struct ether_addr my_eth_addr;
-        rc = get_own_eth_address(fd, ifname, &my_eth_addr);
+        rc = get_own_eth_address(fd, ifname, &own_eth_addr);
         if (rc) {
             perror("get_own_eth_address() ... bind to device");
             close(fd);
@@ -568,30 +1575,333 @@ int real_main(int argc, char **argv)
         }
     }
 
-    sigemptyset(&sigset);
-//  sigaddset(&sigset, SIGALARM);
+    if (o_rcvbuf) {
+        setsockopt_rcvbuf(fd, o_rcvbuf);
+    } else if (o_expected_rate) {
+        setsockopt_rcvbuf(fd, rcvbuf_for_rate(o_expected_rate));
+    }
 
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
-    signal(SIGUSR1, signal_handler);
+    have_rxq_ovfl = (setsockopt_rxq_ovfl(fd) == 0);
+    capture_fd = fd;
 
     rc = flush_socket(fd);
     if (rc) {
         close(fd);
-        return EXIT_FAILURE;
+        return -1;
     }
 
+    /* start accounting after the flush, the drop counters are equal */
+    last_rxq_ovfl = read_packet_statistics(fd);
+    memset(&socket_stats, 0, sizeof(socket_stats));
+
+    /* wake up regularly for timeouts, periodic reports and shutdown */
+    if (o_follow_up) {
+        setsockopt_rcvtimeo(fd, CLAMP(o_follow_up_timeout_ms, 1, 100));
+    } else if (o_socket_stats_interval || o_self_stats_interval
+            || o_summary_interval || o_decompose || o_event_file
+            || o_reflect) {
+        setsockopt_rcvtimeo(fd, 100);
+    }
+
+    return fd;
+}
+
+static void receive_loop(int fd)
+{
+    struct ether_addr *src_eth_addr = NULL;
+    gint64 next_socket_stats;
+    gint64 next_self_stats;
+    gint64 next_summary;
+
+    next_socket_stats = g_get_monotonic_time()
+            + (gint64)o_socket_stats_interval * G_USEC_PER_SEC;
+    next_self_stats = g_get_monotonic_time()
+            + (gint64)o_self_stats_interval * G_USEC_PER_SEC;
+    next_summary = g_get_monotonic_time()
+            + (gint64)o_summary_interval * G_USEC_PER_SEC;
+    self_reset();
+
     while (!do_shutdown) {
         struct msghdr *msg;
         msg = receive_msg(fd, src_eth_addr);
         if (msg) {
-            handle_msg(msg);
+            struct timespec prog_ts;
+
+            clock_gettime(CLOCK_REALTIME, &prog_ts);
+            NL_PROBE2(rx_receive, msg->msg_iov->iov_len,
+                    NL_PROBE_NS(prog_ts));
+            if (o_reflect) {
+                reflect_msg(fd, msg, &prog_ts);
+            } else {
+                process_msg(msg, &prog_ts);
+            }
+        }
+        if (o_follow_up) {
+            pending_expire(g_get_monotonic_time());
+        }
+        if (o_socket_stats_interval
+                && g_get_monotonic_time() >= next_socket_stats) {
+            report_socket_stats(fd);
+            next_socket_stats += (gint64)o_socket_stats_interval
+                    * G_USEC_PER_SEC;
+        }
+        if (o_self_stats_interval
+                && g_get_monotonic_time() >= next_self_stats) {
+            report_self_stats();
+            next_self_stats += (gint64)o_self_stats_interval
+                    * G_USEC_PER_SEC;
+        }
+        if (o_summary_interval && g_get_monotonic_time() >= next_summary) {
+            report_summaries();
+            next_summary += (gint64)o_summary_interval * G_USEC_PER_SEC;
+        }
+    }
+
+    /* flush the test packets still waiting for their follow-up */
+    pending_expire(G_MAXINT64);
+}
+
+/* sleep until the replayed packet is due relative to the first one */
+static void replay_wait(struct timespec *ts, struct timespec *first,
+        struct timespec *start)
+{
+    struct timespec due;
+    gint64 offset;
+
+    if (first->tv_sec == 0 && first->tv_nsec == 0) {
+        *first = *ts;
+        clock_gettime(CLOCK_MONOTONIC, start);
+        return;
+    }
+
+    offset = timespec_diff_ns(first, ts);
+    if (offset <= 0) {
+        return;
+    }
+
+    due.tv_sec = start->tv_sec + offset / 1000000000;
+    due.tv_nsec = start->tv_nsec + offset % 1000000000;
+    if (due.tv_nsec >= 1000000000) {
+        due.tv_sec++;
+        due.tv_nsec -= 1000000000;
+    }
+
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+}
+
+/*
+ * Feed the frames of a pcapng file through handle_msg(). The kernel
+ * timestamps are passed in a SO_TIMESTAMPING control message as on a live
+ * socket.
+ */
+static int replay_pcapng(const gchar *path)
+{
+    static unsigned char buf[2048];
+    union {
+        char buf[CMSG_SPACE(sizeof(struct timespec) * 3)];
+        struct cmsghdr align;
+    } control;
+    struct timespec rx_tss[MAX_TS_RX];
+    struct timespec scm_ts[3];
+    struct timespec first = { 0, 0 };
+    struct timespec start;
+    struct pcapng_file *f;
+    struct cmsghdr *cmsg;
+    struct msghdr msg;
+    struct iovec iov;
+    guint32 len;
+    int rc = 0;
+
+    f = pcapng_open(path);
+    if (f == NULL) {
+        return -1;
+    }
+
+    while (!do_shutdown) {
+        /* frames shorter than a test packet are padded with zeros */
+        memset(buf, 0, sizeof(buf));
+        rc = pcapng_read_packet(f, buf, sizeof(buf), &len, rx_tss);
+        if (rc <= 0) {
+            break;
+        }
+
+        if (o_replay_realtime) {
+            replay_wait(&rx_tss[TS_PROG_RECV], &first, &start);
+        }
+
+        iov.iov_base = buf;
+        iov.iov_len = len;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        memset(scm_ts, 0, sizeof(scm_ts));
+        scm_ts[0] = rx_tss[TS_KERNEL_SW_RX];
+        scm_ts[2] = rx_tss[TS_KERNEL_HW_RX];
+
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SO_TIMESTAMPING;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(scm_ts));
+        memcpy(CMSG_DATA(cmsg), scm_ts, sizeof(scm_ts));
+
+        handle_msg(&msg, &rx_tss[TS_PROG_RECV]);
+
+        if (o_follow_up) {
+            pending_expire(g_get_monotonic_time());
         }
     }
 
-    close(fd);
+    /* flush the test packets still waiting for their follow-up */
+    pending_expire(G_MAXINT64);
+
+    pcapng_close(f);
+
+    return (rc < 0) ? -1 : 0;
+}
+
+int real_main(int argc, char **argv)
+{
+    int rc = 0;
+    int fd = -1;
+    int i;
+    sigset_t sigset;
+
+    parse_command_line_options(&argc, argv);
+
+    if (o_version) {
+        show_version();
+        return 0;
+    }
+
+    if (argc < 2 && o_replay == NULL) {
+        usage();
+        return -1;
+    }
+
+    if ((o_trigger_latency_usec || o_trigger_jitter_usec || o_trigger_loss)
+            && o_event_file == NULL) {
+        fprintf(stderr, "Triggers need an event file (--event-file)\n");
+        return EXIT_FAILURE;
+    }
+
+    if (o_event_pre < 0 || o_event_post < 0 || o_event_holdoff_ms < 0
+            || o_summary_interval < 0) {
+        fprintf(stderr, "Invalid event or summary option\n");
+        return EXIT_FAILURE;
+    }
+
+    if (o_clock_window_ms <= 0) {
+        fprintf(stderr, "Invalid clock estimate window\n");
+        return EXIT_FAILURE;
+    }
+    if (o_clock_correct) {
+        o_clock_estimate = TRUE;
+    }
+
+    if (o_reflect && (o_replay || o_ptp_mode)) {
+        fprintf(stderr, "--reflect needs a live capture of test packets\n");
+        return EXIT_FAILURE;
+    }
+
+    if (o_replay == NULL) {
+        fd = open_live_capture(argv[1]);
+        if (fd < 0) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    sigemptyset(&sigset);
+//  sigaddset(&sigset, SIGALARM);
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    signal(SIGUSR1, signal_handler);
+
+    if (o_shm_name) {
+        stats_shm = stats_shm_create(o_shm_name, STATS_ROLE_RX,
+                "rx-hardware - tx-program");
+        if (stats_shm == NULL) {
+            close(fd);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (o_socket) {
+        stream_server = stream_server_new(o_socket, o_socket_queue_len);
+        if (stream_server == NULL) {
+            close(fd);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (o_pcapng && o_replay == NULL) {
+        pcapng = pcapng_create(o_pcapng);
+        if (pcapng == NULL) {
+            close(fd);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((o_trace_marker || o_breaktrace_usec) && o_replay == NULL) {
+        ftrace = ftrace_open(NULL);
+        if (ftrace == NULL) {
+            close(fd);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (o_event_file) {
+        recorder = recorder_new(o_event_file, MAX_STREAM_ID, o_event_pre,
+                o_event_post, (gint64)o_event_holdoff_ms * 1000000);
+        if (recorder == NULL) {
+            close(fd);
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (i = 0; i < MAX_STAGE; i++) {
+        histogram_init(&stage_hists[i]);
+    }
+    for (i = 0; i < MAX_STREAM_ID; i++) {
+        histogram_init(&summaries[i].latency);
+        skew_init(&skews[i], (gint64)o_clock_window_ms * 1000000);
+    }
+    last_summary = g_get_monotonic_time();
+
+    if (o_replay) {
+        rc = replay_pcapng(o_replay);
+    } else {
+        receive_loop(fd);
+    }
+
+    if (o_decompose) {
+        report_decomposition_summary();
+    }
+    if (o_summary_interval) {
+        report_summaries();
+    }
+    if (o_reflect) {
+        json_t *j = json_reflect(reflect_stats.reflected,
+                reflect_stats.ignored, reflect_stats.send_errors);
+        output_json(j);
+        json_decref(j);
+    }
+
+    recorder_free(recorder);
+    ftrace_close(ftrace);
+    pcapng_close(pcapng);
+    stream_server_free(stream_server);
+    if (stats_shm) {
+        stats_shm_destroy(stats_shm, o_shm_name);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
 
-    return EXIT_SUCCESS;
+    return rc ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
 int main(int argc, char **argv)
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2018, Kontron Europe GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "skew.h"
+
+void skew_init(struct skew *s, gint64 window_ns)
+{
+    memset(s, 0, sizeof(*s));
+    s->window_ns = window_ns;
+}
+
+static gdouble skew_seconds(const struct skew *s, gint64 t_ns)
+{
+    return (t_ns - s->t_ref) / 1e9;
+}
+
+static gdouble skew_predict(const struct skew *s, gdouble t)
+{
+    return s->intercept + s->slope * t;
+}
+
+/* feed the minimum of the finished window to the regression */
+static void skew_update(struct skew *s)
+{
+    gdouble decay = 1.0 - 1.0 / SKEW_HORIZON;
+    gdouble t = skew_seconds(s, s->min_t);
+    gdouble d = s->min_delay;
+    gdouble det;
+
+    /* residual of the window minimum against the previous estimate */
+    if (skew_valid(s)) {
+        gdouble r = d - skew_predict(s, t);
+        s->residual = sqrt(decay * s->residual * s->residual
+                + (1.0 - decay) * r * r);
+    }
+
+    s->sw = decay * s->sw + 1.0;
+    s->st = decay * s->st + t;
+    s->sd = decay * s->sd + d;
+    s->stt = decay * s->stt + t * t;
+    s->std = decay * s->std + t * d;
+
+    if (s->windows == 0) {
+        s->base = s->min_delay;
+    }
+    s->windows++;
+    s->last_min_t = s->min_t;
+    s->last_min_delay = s->min_delay;
+
+    det = s->sw * s->stt - s->st * s->st;
+    if (s->windows < 2 || det <= 0) {
+        s->slope = 0;
+        s->intercept = d;
+        return;
+    }
+
+    s->slope = (s->sw * s->std - s->st * s->sd) / det;
+    s->intercept = (s->sd - s->slope * s->st) / s->sw;
+}
+
+gboolean skew_add(struct skew *s, gint64 tx_ns, gint64 delay_ns)
+{
+    gboolean updated = FALSE;
+
+    if (!s->started) {
+        s->started = TRUE;
+        s->t_ref = tx_ns;
+        s->window_end = tx_ns + s->window_ns;
+        s->min_t = tx_ns;
+        s->min_delay = delay_ns;
+        return FALSE;
+    }
+
+    /* a gap may skip windows, the next one starts with this packet */
+    if (tx_ns >= s->window_end) {
+        skew_update(s);
+        updated = TRUE;
+        s->window_end += s->window_ns;
+        if (tx_ns >= s->window_end) {
+            s->window_end = tx_ns + s->window_ns;
+        }
+        s->min_t = tx_ns;
+        s->min_delay = delay_ns;
+    } else if (delay_ns < s->min_delay) {
+        s->min_t = tx_ns;
+        s->min_delay = delay_ns;
+    }
+
+    return updated;
+}
+
+gboolean skew_valid(const struct skew *s)
+{
+    return s->windows >= 2;
+}
+
+gint64 skew_envelope(const struct skew *s, gint64 tx_ns)
+{
+    return llround(skew_predict(s, skew_seconds(s, tx_ns)));
+}
+
+gint64 skew_correction(const struct skew *s, gint64 tx_ns)
+{
+    return skew_envelope(s, tx_ns) - s->base;
+}
+
+gdouble skew_drift_ppm(const struct skew *s)
+{
+    /* nsec per second */
+    return s->slope / 1e3;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2018, Kontron Europe GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SKEW_H__
+#define __SKEW_H__
+
+/* windows of the exponentially weighted regression */
+#define SKEW_HORIZON 16
+
+/*
+ * Online estimate of the offset and drift between the sender and the
+ * receiver clock from the one-way delays of a stream. The minimum delay of
+ * each window lies on the lower envelope, i.e. the clock offset plus the
+ * minimum path delay, which is free of queueing. A line is fitted through
+ * the window minima by exponentially weighted least squares, so the state
+ * is constant. Times are in nsec of the sender clock.
+ */
+struct skew {
+    gint64 window_ns;
+
+    /* times of the regression are relative to the first sample */
+    gboolean started;
+    gint64 t_ref;
+
+    /* the window in progress */
+    gint64 window_end;
+    gint64 min_t;
+    gint64 min_delay;
+
+    /* weighted sums over the window minima, t in seconds */
+    gdouble sw;
+    gdouble st;
+    gdouble sd;
+    gdouble stt;
+    gdouble std;
+
+    guint64 windows;
+    gint64 last_min_t;
+    gint64 last_min_delay;
+    gint64 base;
+    gdouble slope;
+    gdouble intercept;
+    gdouble residual;
+};
+
+void skew_init(struct skew *s, gint64 window_ns);
+
+/*
+ * Add the delay of a packet sent at tx_ns. Returns TRUE if this completed a
+ * window and updated the estimate.
+ */
+gboolean skew_add(struct skew *s, gint64 tx_ns, gint64 delay_ns);
+
+/* the estimate needs two windows */
+gboolean skew_valid(const struct skew *s);
+
+/* lower envelope, clock offset plus minimum path delay, at tx_ns */
+gint64 skew_envelope(const struct skew *s, gint64 tx_ns);
+
+/* change of the lower envelope at tx_ns since the first window */
+gint64 skew_correction(const struct skew *s, gint64 tx_ns);
+
+/* drift of the receiver clock against the sender clock in ppm */
+gdouble skew_drift_ppm(const struct skew *s);
+
+#endif /* __SKEW_H__ */
@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2018, Kontron Europe GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include <jansson.h>
+
+#include "stats.h"
+
+#ifndef VERSION
+#define VERSION "dev"
+#endif
+
+static gchar *help_description = NULL;
+static gint o_json = FALSE;
+static gint o_histogram = FALSE;
+static gint o_watch_ms = 0;
+static gint o_version = 0;
+
+static const gdouble percentiles[] = { 50.0, 90.0, 99.0, 99.9 };
+
+static const char *role_name(guint32 role)
+{
+    switch (role) {
+    case STATS_ROLE_RX:
+        return "rx";
+    case STATS_ROLE_TX:
+        return "tx";
+    default:
+        return "unknown";
+    }
+}
+
+static json_t *json_stream(guint idx, struct stats_stream *s)
+{
+    json_t *latency;
+    json_t *object;
+    guint i;
+
+    object = json_pack("{sisIsIsI}",
+            "stream-id", idx,
+            "packets", (json_int_t)s->packets,
+            "dropped-packets", (json_int_t)s->dropped,
+            "sequence-errors", (json_int_t)s->seq_errors);
+
+    latency = json_pack("{sIsIsIsI}",
+            "count", (json_int_t)s->latency.count,
+            "last", (json_int_t)s->latency_last,
+            "min", (json_int_t)(s->latency.count ? s->latency.min : 0),
+            "max", (json_int_t)(s->latency.count ? s->latency.max : 0));
+
+    for (i = 0; i < G_N_ELEMENTS(percentiles); i++) {
+        gchar *name = g_strdup_printf("p%g", percentiles[i]);
+        json_object_set_new(latency, name, json_integer(
+                histogram_percentile(&s->latency, percentiles[i])));
+        g_free(name);
+    }
+    json_object_set_new(object, "latency-ns", latency);
+
+    /* sparse list of [lower bound, upper bound, count] */
+    if (o_histogram) {
+        json_t *buckets = json_array();
+        for (i = 0; i < HIST_NUM_BUCKETS; i++) {
+            if (s->latency.buckets[i]) {
+                json_array_append_new(buckets, json_pack("[III]",
+                        (json_int_t)histogram_bucket_lower(i),
+                        (json_int_t)histogram_bucket_upper(i),
+                        (json_int_t)s->latency.buckets[i]));
+            }
+        }
+        json_object_set_new(latency, "underflow",
+                json_integer(s->latency.underflow));
+        json_object_set_new(latency, "histogram", buckets);
+    }
+
+    return object;
+}
+
+static void report_inconsistent(guint idx)
+{
+    fprintf(stderr, "stream %u: no consistent statistics, the writer stalled"
+            " or died during an update\n", idx);
+}
+
+static void dump_json(struct stats_shm *shm)
+{
+    json_t *streams = json_array();
+    json_t *j;
+    char *s;
+    guint i;
+
+    for (i = 0; i < shm->hdr.num_streams && i < STATS_MAX_STREAMS; i++) {
+        struct stats_stream copy;
+        if (stats_read_stream(shm, i, &copy) < 0) {
+            report_inconsistent(i);
+            continue;
+        }
+        if (copy.active) {
+            json_array_append_new(streams, json_stream(i, &copy));
+        }
+    }
+
+    j = json_pack("{sss{sssisIssso}}",
+            "type", "stat",
+            "object",
+            "role", role_name(shm->hdr.role),
+            "pid", shm->hdr.pid,
+            "start-time-ns", (json_int_t)shm->hdr.start_time,
+            "latency", shm->hdr.latency_name,
+            "streams", streams);
+
+    s = json_dumps(j, JSON_COMPACT);
+    if (s) {
+        printf("%s\n", s);
+        free(s);
+    }
+    json_decref(j);
+}
+
+static void dump_text(struct stats_shm *shm)
+{
+    guint i;
+
+    g_printf("%s pid %u, latency %s [ns]\n", role_name(shm->hdr.role),
+            shm->hdr.pid, shm->hdr.latency_name);
+    g_printf("%6s %12s %10s %10s %12s %12s %12s %12s %12s %12s\n",
+            "stream", "packets", "dropped", "seq-err", "last", "min", "max",
+            "p50", "p99", "p99.9");
+
+    for (i = 0; i < shm->hdr.num_streams && i < STATS_MAX_STREAMS; i++) {
+        struct stats_stream s;
+
+        if (stats_read_stream(shm, i, &s) < 0) {
+            report_inconsistent(i);
+            continue;
+        }
+        if (!s.active) {
+            continue;
+        }
+
+        g_printf("%6u %12" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT
+                " %10" G_GUINT64_FORMAT " %12" G_GINT64_FORMAT
+                " %12" G_GINT64_FORMAT " %12" G_GINT64_FORMAT
+                " %12" G_GINT64_FORMAT " %12" G_GINT64_FORMAT
+                " %12" G_GINT64_FORMAT "\n",
+                i, s.packets, s.dropped, s.seq_errors, s.latency_last,
+                s.latency.count ? s.latency.min : 0,
+                s.latency.count ? s.latency.max : 0,
+                histogram_percentile(&s.latency, 50.0),
+                histogram_percentile(&s.latency, 99.0),
+                histogram_percentile(&s.latency, 99.9));
+    }
+}
+
+void usage(void)
+{
+    g_printf("%s", help_description);
+}
+
+static GOptionEntry entries[] = {
+    { "json",      'j', 0, G_OPTION_ARG_NONE,
+            &o_json, "Print statistics in JSON format", NULL },
+    { "histogram", 'H', 0, G_OPTION_ARG_NONE,
+            &o_histogram, "Include latency histogram in JSON output", NULL },
+    { "watch",     'w', 0, G_OPTION_ARG_INT,
+            &o_watch_ms, "Repeat every INTERVAL msec", "INTERVAL" },
+    { "version",   'V', 0, G_OPTION_ARG_NONE,
+            &o_version, "Show version information and exit", NULL },
+    { NULL, 0, 0, 0, NULL, NULL, NULL }
+};
+
+static gint parse_command_line_options(gint *argc, char **argv)
+{
+    GError *error = NULL;
+    GOptionContext *context;
+
+    context = g_option_context_new("NAME - show live statistics");
+
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_set_description(context,
+        "This tool reads the statistics published by nl-rx or nl-tx\n"
+        "with the --shm option.\n"
+    );
+
+    if (!g_option_context_parse(context, argc, &argv, &error)) {
+        g_print("option parsing failed: %s\n", error->message);
+        exit(1);
+    }
+
+    help_description = g_option_context_get_help(context, 0, NULL);
+    g_option_context_free(context);
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct stats_shm *shm;
+
+    parse_command_line_options(&argc, argv);
+
+    if (o_version) {
+        g_printf("%s\n", VERSION);
+        return 0;
+    }
+
+    if (argc < 2) {
+        usage();
+        return -1;
+    }
+
+    shm = stats_shm_open(argv[1]);
+    if (shm == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    do {
+        if (o_json) {
+            dump_json(shm);
+        } else {
+            dump_text(shm);
+        }
+        fflush(stdout);
+
+        if (o_watch_ms) {
+            usleep(o_watch_ms * 1000);
+        }
+    } while (o_watch_ms);
+
+    stats_shm_close(shm);
+
+    return EXIT_SUCCESS;
+}
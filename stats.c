@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2018, Kontron Europe GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "stats.h"
+
+/* shm_open() wants names with a leading slash */
+static gchar *stats_shm_name(const gchar *name)
+{
+    if (name[0] == '/') {
+        return g_strdup(name);
+    }
+
+    return g_strdup_printf("/%s", name);
+}
+
+struct stats_shm *stats_shm_create(const gchar *name, guint32 role,
+        const gchar *latency_name)
+{
+    struct stats_shm *shm;
+    struct timespec now;
+    gchar *shm_name;
+    int fd;
+    int i;
+
+    shm_name = stats_shm_name(name);
+    fd = shm_open(shm_name, O_CREAT | O_RDWR, 0644);
+    g_free(shm_name);
+    if (fd < 0) {
+        perror("shm_open");
+        return NULL;
+    }
+
+    if (ftruncate(fd, sizeof(struct stats_shm)) < 0) {
+        perror("ftruncate");
+        close(fd);
+        return NULL;
+    }
+
+    shm = mmap(NULL, sizeof(struct stats_shm), PROT_READ | PROT_WRITE,
+            MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+
+    memset(shm, 0, sizeof(*shm));
+    for (i = 0; i < STATS_MAX_STREAMS; i++) {
+        histogram_init(&shm->streams[i].latency);
+    }
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    shm->hdr.version = STATS_VERSION;
+    shm->hdr.size = sizeof(struct stats_shm);
+    shm->hdr.role = role;
+    shm->hdr.num_streams = STATS_MAX_STREAMS;
+    shm->hdr.pid = getpid();
+    shm->hdr.start_time = now.tv_sec * G_GINT64_CONSTANT(1000000000)
+            + now.tv_nsec;
+    g_strlcpy(shm->hdr.latency_name, latency_name,
+            sizeof(shm->hdr.latency_name));
+
+    /* the magic marks the segment as initialized */
+    __atomic_store_n(&shm->hdr.magic, STATS_MAGIC, __ATOMIC_RELEASE);
+
+    return shm;
+}
+
+void stats_shm_destroy(struct stats_shm *shm, const gchar *name)
+{
+    gchar *shm_name;
+
+    if (shm == NULL) {
+        return;
+    }
+
+    munmap(shm, sizeof(struct stats_shm));
+
+    shm_name = stats_shm_name(name);
+    shm_unlink(shm_name);
+    g_free(shm_name);
+}
+
+struct stats_shm *stats_shm_open(const gchar *name)
+{
+    struct stats_shm *shm;
+    struct stat st;
+    gchar *shm_name;
+    int fd;
+
+    shm_name = stats_shm_name(name);
+    fd = shm_open(shm_name, O_RDONLY, 0);
+    g_free(shm_name);
+    if (fd < 0) {
+        perror("shm_open");
+        return NULL;
+    }
+
+    if (fstat(fd, &st) < 0 || (gsize)st.st_size < sizeof(struct stats_header)) {
+        fprintf(stderr, "shared memory segment too small\n");
+        close(fd);
+        return NULL;
+    }
+
+    shm = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+
+    if (__atomic_load_n(&shm->hdr.magic, __ATOMIC_ACQUIRE) != STATS_MAGIC
+            || shm->hdr.version != STATS_VERSION
+            || shm->hdr.size != sizeof(struct stats_shm)
+            || (gsize)st.st_size < sizeof(struct stats_shm)) {
+        fprintf(stderr, "incompatible shared memory segment\n");
+        munmap(shm, st.st_size);
+        return NULL;
+    }
+
+    return shm;
+}
+
+void stats_shm_close(struct stats_shm *shm)
+{
+    if (shm) {
+        munmap(shm, sizeof(struct stats_shm));
+    }
+}
+
+int stats_read_stream(struct stats_shm *shm, guint idx,
+        struct stats_stream *copy)
+{
+    struct stats_stream *s = &shm->streams[idx];
+    guint32 seq1;
+    guint32 seq2;
+    guint i;
+
+    for (i = 0; i < STATS_READ_RETRIES; i++) {
+        seq1 = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+        if (seq1 & 1) {
+            sched_yield();
+            continue;
+        }
+        memcpy(copy, s, sizeof(*copy));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        seq2 = __atomic_load_n(&s->seq, __ATOMIC_RELAXED);
+        if (seq1 == seq2) {
+            return 0;
+        }
+    }
+
+    /* the writer died or stalled in the middle of an update */
+    return -1;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2018, Kontron Europe GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include "histogram.h"
+
+/*
+ * Live statistics in a POSIX shared memory segment.
+ *
+ * The layout is versioned by STATS_VERSION and must only be extended at the
+ * end. Every stream is protected by a seqlock: the writer increments the
+ * sequence counter before and after an update, a reader retries as long as
+ * the counter is odd or has changed while copying. Hence the writer never
+ * blocks and does not need a syscall per update.
+ */
+#define STATS_MAGIC 0x54534c4e /* "NLST" */
+#define STATS_VERSION 1
+#define STATS_MAX_STREAMS 16
+
+enum {
+    STATS_ROLE_RX = 1,
+    STATS_ROLE_TX,
+};
+
+struct stats_stream {
+    guint32 seq;
+    guint32 active;
+
+    guint64 packets;
+    guint64 dropped;
+    guint64 seq_errors;
+    gint64 latency_last;
+    struct histogram latency;
+};
+
+struct stats_header {
+    guint32 magic;
+    guint32 version;
+    guint32 size;
+    guint32 role;
+    guint32 num_streams;
+    guint32 pid;
+    gint64 start_time;
+
+    /* description of the latency values, e.g. "rx-hardware - tx-program" */
+    gchar latency_name[64];
+};
+
+struct stats_shm {
+    struct stats_header hdr;
+    struct stats_stream streams[STATS_MAX_STREAMS];
+};
+
+struct stats_shm *stats_shm_create(const gchar *name, guint32 role,
+        const gchar *latency_name);
+
+void stats_shm_destroy(struct stats_shm *shm, const gchar *name);
+
+struct stats_shm *stats_shm_open(const gchar *name);
+
+void stats_shm_close(struct stats_shm *shm);
+
+/* number of attempts to get a consistent copy of a stream */
+#define STATS_READ_RETRIES 1000
+
+/*
+ * Take a consistent copy of a stream. Returns -1 if the writer did not finish
+ * an update within STATS_READ_RETRIES attempts.
+ */
+int stats_read_stream(struct stats_shm *shm, guint idx,
+        struct stats_stream *copy);
+
+static inline void stats_write_begin(struct stats_stream *s)
+{
+    __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void stats_write_end(struct stats_stream *s)
+{
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELAXED);
+}
+
+#endif /* __STATS_H__ */
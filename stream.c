@@ -0,0 +1,597 @@
+/*
+ * Copyright (c) 2018, Kontron Europe GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "stream.h"
+
+enum {
+    STREAM_UNIX,
+    STREAM_UDP,
+};
+
+struct subscriber {
+    gboolean active;
+
+    /* UNIX: connected socket, UDP: address of the subscriber */
+    int fd;
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+
+    /* ring of queued records, protected by the server lock */
+    char **queue;
+    guint head;
+    guint len;
+    guint64 dropped;
+    guint64 dropped_pending;
+
+    /* record currently written, owned by the server thread */
+    char *cur;
+    gsize cur_len;
+    gsize cur_off;
+};
+
+struct stream_server {
+    int type;
+    int fd;
+    int wake_fd;
+    gchar *path;
+    guint queue_len;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    gboolean running;
+
+    struct subscriber subscribers[STREAM_MAX_SUBSCRIBERS];
+};
+
+static void subscriber_clear(struct stream_server *server,
+        struct subscriber *sub)
+{
+    guint i;
+
+    if (sub->dropped) {
+        fprintf(stderr, "stream subscriber removed, %" G_GUINT64_FORMAT
+                " records dropped\n", sub->dropped);
+    }
+
+    if (server->type == STREAM_UNIX && sub->fd >= 0) {
+        close(sub->fd);
+    }
+
+    for (i = 0; i < sub->len; i++) {
+        g_free(sub->queue[(sub->head + i) % server->queue_len]);
+    }
+    g_free(sub->queue);
+    g_free(sub->cur);
+
+    memset(sub, 0, sizeof(*sub));
+    sub->fd = -1;
+}
+
+static struct subscriber *subscriber_add(struct stream_server *server)
+{
+    struct subscriber *sub = NULL;
+    int i;
+
+    pthread_mutex_lock(&server->lock);
+    for (i = 0; i < STREAM_MAX_SUBSCRIBERS; i++) {
+        if (!server->subscribers[i].active) {
+            sub = &server->subscribers[i];
+            memset(sub, 0, sizeof(*sub));
+            sub->fd = -1;
+            sub->queue = g_new0(char *, server->queue_len);
+            sub->active = TRUE;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&server->lock);
+
+    return sub;
+}
+
+static void subscriber_remove(struct stream_server *server,
+        struct subscriber *sub)
+{
+    pthread_mutex_lock(&server->lock);
+    subscriber_clear(server, sub);
+    pthread_mutex_unlock(&server->lock);
+}
+
+static struct subscriber *subscriber_find_addr(struct stream_server *server,
+        struct sockaddr_storage *addr, socklen_t addrlen)
+{
+    int i;
+
+    for (i = 0; i < STREAM_MAX_SUBSCRIBERS; i++) {
+        struct subscriber *sub = &server->subscribers[i];
+        if (sub->active && sub->addrlen == addrlen
+                && !memcmp(&sub->addr, addr, addrlen)) {
+            return sub;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Take the next record of a subscriber. If records have been dropped since
+ * the last delivery the subscriber gets a notice first.
+ */
+static gboolean subscriber_next(struct stream_server *server,
+        struct subscriber *sub)
+{
+    pthread_mutex_lock(&server->lock);
+    if (sub->dropped_pending) {
+        sub->cur = g_strdup_printf("{\"type\":\"stream-drops\",\"object\":"
+                "{\"dropped-records\":%" G_GUINT64_FORMAT "}}\n",
+                sub->dropped_pending);
+        sub->dropped_pending = 0;
+    } else if (sub->len) {
+        sub->cur = sub->queue[sub->head];
+        sub->queue[sub->head] = NULL;
+        sub->head = (sub->head + 1) % server->queue_len;
+        sub->len--;
+    }
+    pthread_mutex_unlock(&server->lock);
+
+    if (sub->cur == NULL) {
+        return FALSE;
+    }
+
+    sub->cur_len = strlen(sub->cur);
+    sub->cur_off = 0;
+
+    return TRUE;
+}
+
+static gboolean subscriber_pending(struct stream_server *server,
+        struct subscriber *sub)
+{
+    gboolean pending;
+
+    pthread_mutex_lock(&server->lock);
+    pending = sub->cur || sub->len || sub->dropped_pending;
+    pthread_mutex_unlock(&server->lock);
+
+    return pending;
+}
+
+/* returns -1 if the subscriber is gone, 1 if it would block, 0 if done */
+static int subscriber_flush(struct stream_server *server,
+        struct subscriber *sub)
+{
+    ssize_t n;
+
+    while (sub->cur || subscriber_next(server, sub)) {
+        if (server->type == STREAM_UNIX) {
+            n = send(sub->fd, sub->cur + sub->cur_off,
+                    sub->cur_len - sub->cur_off, MSG_DONTWAIT | MSG_NOSIGNAL);
+        } else {
+            n = sendto(server->fd, sub->cur, sub->cur_len,
+                    MSG_DONTWAIT | MSG_NOSIGNAL,
+                    (struct sockaddr *)&sub->addr, sub->addrlen);
+        }
+
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 1;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        sub->cur_off += n;
+        if (sub->cur_off >= sub->cur_len || server->type == STREAM_UDP) {
+            g_free(sub->cur);
+            sub->cur = NULL;
+        }
+    }
+
+    return 0;
+}
+
+static void handle_unix_accept(struct stream_server *server)
+{
+    struct subscriber *sub;
+    int fd;
+
+    fd = accept(server->fd, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    sub = subscriber_add(server);
+    if (sub == NULL) {
+        fprintf(stderr, "stream: too many subscribers\n");
+        close(fd);
+        return;
+    }
+    sub->fd = fd;
+}
+
+static void handle_udp_request(struct stream_server *server)
+{
+    struct sockaddr_storage addr;
+    socklen_t addrlen = sizeof(addr);
+    struct subscriber *sub;
+    char buf[64];
+    ssize_t n;
+
+    n = recvfrom(server->fd, buf, sizeof(buf) - 1, MSG_DONTWAIT,
+            (struct sockaddr *)&addr, &addrlen);
+    if (n < 0) {
+        return;
+    }
+    buf[n] = '\0';
+
+    sub = subscriber_find_addr(server, &addr, addrlen);
+    if (g_str_has_prefix(buf, "unsubscribe")) {
+        if (sub) {
+            subscriber_remove(server, sub);
+        }
+        return;
+    }
+
+    if (sub == NULL) {
+        sub = subscriber_add(server);
+        if (sub == NULL) {
+            fprintf(stderr, "stream: too many subscribers\n");
+            return;
+        }
+        memcpy(&sub->addr, &addr, addrlen);
+        sub->addrlen = addrlen;
+    }
+}
+
+static void *stream_thread(void *arg)
+{
+    struct stream_server *server = arg;
+    struct pollfd pfds[STREAM_MAX_SUBSCRIBERS + 2];
+    struct subscriber *subs[STREAM_MAX_SUBSCRIBERS + 2];
+
+    while (server->running) {
+        gboolean udp_blocked = FALSE;
+        guint64 val;
+        int nfds = 0;
+        int i;
+
+        /* write out everything that is queued */
+        for (i = 0; i < STREAM_MAX_SUBSCRIBERS; i++) {
+            struct subscriber *sub = &server->subscribers[i];
+            int rc;
+
+            if (!sub->active) {
+                continue;
+            }
+
+            rc = subscriber_flush(server, sub);
+            if (rc < 0) {
+                subscriber_remove(server, sub);
+            } else if (rc > 0 && server->type == STREAM_UDP) {
+                udp_blocked = TRUE;
+            }
+        }
+
+        pfds[nfds].fd = server->wake_fd;
+        pfds[nfds].events = POLLIN;
+        subs[nfds++] = NULL;
+
+        pfds[nfds].fd = server->fd;
+        pfds[nfds].events = POLLIN | (udp_blocked ? POLLOUT : 0);
+        subs[nfds++] = NULL;
+
+        for (i = 0; i < STREAM_MAX_SUBSCRIBERS; i++) {
+            struct subscriber *sub = &server->subscribers[i];
+
+            if (!sub->active || server->type != STREAM_UNIX) {
+                continue;
+            }
+
+            pfds[nfds].fd = sub->fd;
+            pfds[nfds].events = POLLIN;
+            if (subscriber_pending(server, sub)) {
+                pfds[nfds].events |= POLLOUT;
+            }
+            subs[nfds++] = sub;
+        }
+
+        if (poll(pfds, nfds, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            break;
+        }
+
+        if (pfds[0].revents & POLLIN) {
+            if (read(server->wake_fd, &val, sizeof(val)) < 0) {
+                /* nothing to do, the counter is reset anyway */
+            }
+        }
+
+        if (pfds[1].revents & POLLIN) {
+            if (server->type == STREAM_UNIX) {
+                handle_unix_accept(server);
+            } else {
+                handle_udp_request(server);
+            }
+        }
+
+        /* subscribers do not send anything, any input is discarded */
+        for (i = 2; i < nfds; i++) {
+            char buf[256];
+            ssize_t n;
+
+            if (pfds[i].revents & (POLLERR | POLLNVAL)) {
+                subscriber_remove(server, subs[i]);
+                continue;
+            }
+
+            if (pfds[i].revents & (POLLIN | POLLHUP)) {
+                n = recv(pfds[i].fd, buf, sizeof(buf), MSG_DONTWAIT);
+                if (n == 0 || (n < 0 && errno != EAGAIN)) {
+                    subscriber_remove(server, subs[i]);
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static int open_unix_socket(struct stream_server *server, const gchar *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "stream: socket path too long\n");
+        return -1;
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket(AF_UNIX)");
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    /* remove a stale socket of a previous run */
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind stream socket");
+        close(fd);
+        return -1;
+    }
+
+    if (listen(fd, STREAM_MAX_SUBSCRIBERS) < 0) {
+        perror("listen stream socket");
+        close(fd);
+        return -1;
+    }
+
+    server->type = STREAM_UNIX;
+    server->path = g_strdup(path);
+
+    return fd;
+}
+
+static int open_udp_socket(struct stream_server *server, const gchar *spec)
+{
+    struct addrinfo hints;
+    struct addrinfo *res;
+    const gchar *port;
+    gchar *host = NULL;
+    int fd;
+    int rc;
+
+    /* [HOST:]PORT */
+    port = strrchr(spec, ':');
+    if (port) {
+        host = g_strndup(spec, port - spec);
+        port++;
+    } else {
+        port = spec;
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    rc = getaddrinfo(host, port, &hints, &res);
+    g_free(host);
+    if (rc) {
+        fprintf(stderr, "stream: %s\n", gai_strerror(rc));
+        return -1;
+    }
+
+    fd = socket(res->ai_family, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("socket(SOCK_DGRAM)");
+        freeaddrinfo(res);
+        return -1;
+    }
+
+    if (bind(fd, res->ai_addr, res->ai_addrlen) < 0) {
+        perror("bind stream socket");
+        close(fd);
+        freeaddrinfo(res);
+        return -1;
+    }
+    freeaddrinfo(res);
+
+    server->type = STREAM_UDP;
+
+    return fd;
+}
+
+struct stream_server *stream_server_new(const gchar *address, guint queue_len)
+{
+    struct stream_server *server;
+    int i;
+
+    g_return_val_if_fail(address != NULL, NULL);
+
+    server = g_new0(struct stream_server, 1);
+    server->queue_len = MAX(queue_len, 1);
+    for (i = 0; i < STREAM_MAX_SUBSCRIBERS; i++) {
+        server->subscribers[i].fd = -1;
+    }
+
+    if (g_str_has_prefix(address, "udp:")) {
+        server->fd = open_udp_socket(server, address + strlen("udp:"));
+    } else if (g_str_has_prefix(address, "unix:")) {
+        server->fd = open_unix_socket(server, address + strlen("unix:"));
+    } else {
+        server->fd = open_unix_socket(server, address);
+    }
+
+    if (server->fd < 0) {
+        g_free(server->path);
+        g_free(server);
+        return NULL;
+    }
+
+    server->wake_fd = eventfd(0, EFD_NONBLOCK);
+    if (server->wake_fd < 0) {
+        perror("eventfd");
+        close(server->fd);
+        g_free(server->path);
+        g_free(server);
+        return NULL;
+    }
+
+    pthread_mutex_init(&server->lock, NULL);
+    server->running = TRUE;
+
+    if (pthread_create(&server->thread, NULL, stream_thread, server)) {
+        perror("pthread_create");
+        close(server->wake_fd);
+        close(server->fd);
+        g_free(server->path);
+        g_free(server);
+        return NULL;
+    }
+
+    return server;
+}
+
+void stream_server_publish(struct stream_server *server, const char *record)
+{
+    gboolean wakeup = FALSE;
+    int i;
+
+    pthread_mutex_lock(&server->lock);
+    for (i = 0; i < STREAM_MAX_SUBSCRIBERS; i++) {
+        struct subscriber *sub = &server->subscribers[i];
+        guint tail;
+
+        if (!sub->active) {
+            continue;
+        }
+
+        /* drop the oldest record, a slow subscriber must not block us */
+        if (sub->len == server->queue_len) {
+            g_free(sub->queue[sub->head]);
+            sub->queue[sub->head] = NULL;
+            sub->head = (sub->head + 1) % server->queue_len;
+            sub->len--;
+            sub->dropped++;
+            sub->dropped_pending++;
+        }
+
+        if (sub->len == 0) {
+            wakeup = TRUE;
+        }
+
+        tail = (sub->head + sub->len) % server->queue_len;
+        sub->queue[tail] = g_strdup_printf("%s\n", record);
+        sub->len++;
+    }
+    pthread_mutex_unlock(&server->lock);
+
+    if (wakeup) {
+        guint64 val = 1;
+        if (write(server->wake_fd, &val, sizeof(val)) < 0) {
+            /* the server thread is woken up already */
+        }
+    }
+}
+
+void stream_server_free(struct stream_server *server)
+{
+    guint64 val = 1;
+    int i;
+
+    if (server == NULL) {
+        return;
+    }
+
+    server->running = FALSE;
+    if (write(server->wake_fd, &val, sizeof(val)) < 0) {
+        perror("write eventfd");
+    }
+    pthread_join(server->thread, NULL);
+
+    for (i = 0; i < STREAM_MAX_SUBSCRIBERS; i++) {
+        if (server->subscribers[i].active) {
+            subscriber_clear(server, &server->subscribers[i]);
+        }
+    }
+
+    close(server->wake_fd);
+    close(server->fd);
+    if (server->path) {
+        unlink(server->path);
+        g_free(server->path);
+    }
+    pthread_mutex_destroy(&server->lock);
+    g_free(server);
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2018, Kontron Europe GmbH
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __STREAM_H__
+#define __STREAM_H__
+
+#define STREAM_MAX_SUBSCRIBERS 16
+#define STREAM_DEFAULT_QUEUE_LEN 1024
+
+struct stream_server;
+
+/*
+ * Serve records to multiple subscribers. The address is either
+ * "unix:PATH" (or a plain PATH) for a UNIX stream socket or
+ * "udp:[HOST:]PORT" for UDP, where any datagram sent to the port subscribes
+ * its sender and "unsubscribe" removes it again.
+ */
+struct stream_server *stream_server_new(const gchar *address, guint queue_len);
+
+/*
+ * Queue a record for all subscribers. This never blocks on a subscriber; if
+ * a queue is full its oldest record is dropped.
+ */
+void stream_server_publish(struct stream_server *server, const char *record);
+
+void stream_server_free(struct stream_server *server);
+
+#endif /* __STREAM_H__ */
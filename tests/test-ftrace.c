@@ -0,0 +1,94 @@
+/*
+ *  (C) Copyright 2021 Kontron Europe GmbH, Saarbruecken
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <libgen.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "../ftrace.c"
+
+
+static gchar *read_file(const gchar *dir, const gchar *name)
+{
+    gchar *path = g_strdup_printf("%s/%s", dir, name);
+    gchar *contents;
+
+    g_assert(g_file_get_contents(path, &contents, NULL, NULL));
+    g_free(path);
+
+    return contents;
+}
+
+static void write_file(const gchar *dir, const gchar *name,
+        const gchar *contents)
+{
+    gchar *path = g_strdup_printf("%s/%s", dir, name);
+
+    g_assert(g_file_set_contents(path, contents, -1, NULL));
+    g_free(path);
+}
+
+static void remove_file(const gchar *dir, const gchar *name)
+{
+    gchar *path = g_strdup_printf("%s/%s", dir, name);
+
+    g_unlink(path);
+    g_free(path);
+}
+
+/*
+ * TESTS
+ */
+static void test_mark_break(void)
+{
+    struct ftrace *t;
+    gchar *dir;
+    gchar *s;
+
+    dir = g_strdup_printf("/tmp/nl-test-ftrace-%d", getpid());
+    g_assert_cmpint(g_mkdir(dir, 0700), ==, 0);
+    write_file(dir, "trace_marker", "");
+    write_file(dir, "tracing_on", "1");
+
+    t = ftrace_open(dir);
+    g_assert(t != NULL);
+
+    ftrace_mark(t, "seq=%d stage=%s", 1, "sent");
+    g_assert(ftrace_break(t, "break seq=%d", 2));
+    g_assert(!ftrace_break(t, "break seq=%d", 3));
+    ftrace_close(t);
+
+    s = read_file(dir, "trace_marker");
+    g_assert_cmpstr(s, ==, "seq=1 stage=sentbreak seq=2");
+    g_free(s);
+
+    s = read_file(dir, "tracing_on");
+    g_assert_cmpstr(s, ==, "0");
+    g_free(s);
+
+    remove_file(dir, "trace_marker");
+    remove_file(dir, "tracing_on");
+    g_rmdir(dir);
+    g_free(dir);
+}
+
+static void test_missing(void)
+{
+    g_assert(ftrace_open("/nonexistent") == NULL);
+}
+
+int main(int argc, char** argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/ftrace/mark_break", test_mark_break);
+    g_test_add_func("/ftrace/missing", test_missing);
+
+    return g_test_run();
+}
@@ -0,0 +1,106 @@
+/*
+ *  (C) Copyright 2021 Kontron Europe GmbH, Saarbruecken
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <libgen.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "../histogram.c"
+
+
+/*
+ * TESTS
+ */
+static void test_histogram_bucket(void)
+{
+    guint i;
+
+    g_assert_cmpint(histogram_bucket(0), ==, 0);
+    g_assert_cmpint(histogram_bucket(15), ==, 15);
+    g_assert_cmpint(histogram_bucket(16), ==, 16);
+    g_assert_cmpint(histogram_bucket(31), ==, 31);
+    g_assert_cmpint(histogram_bucket(32), ==, 32);
+    g_assert_cmpint(histogram_bucket(33), ==, 32);
+    g_assert_cmpint(histogram_bucket(G_MAXINT64), ==, HIST_NUM_BUCKETS - 1);
+
+    /* buckets are contiguous and contain their bounds */
+    for (i = 1; i < HIST_NUM_BUCKETS; i++) {
+        g_assert_cmpint(histogram_bucket_lower(i), ==,
+                histogram_bucket_upper(i - 1) + 1);
+        g_assert_cmpint(histogram_bucket(histogram_bucket_lower(i)), ==, i);
+        g_assert_cmpint(histogram_bucket(histogram_bucket_upper(i)), ==, i);
+    }
+}
+
+static void test_histogram_percentile(void)
+{
+    struct histogram h;
+    gint64 p;
+    int i;
+
+    histogram_init(&h);
+    g_assert_cmpint(histogram_percentile(&h, 50.0), ==, 0);
+
+    for (i = 1; i <= 1000; i++) {
+        histogram_add(&h, i * 1000);
+    }
+    g_assert_cmpint(h.count, ==, 1000);
+    g_assert_cmpint(h.min, ==, 1000);
+    g_assert_cmpint(h.max, ==, 1000000);
+
+    /* relative error is below 1/16 */
+    p = histogram_percentile(&h, 50.0);
+    g_assert_cmpint(p, >=, 500000);
+    g_assert_cmpint(p, <=, 500000 + 500000 / HIST_SUB_BUCKETS);
+
+    p = histogram_percentile(&h, 99.0);
+    g_assert_cmpint(p, >=, 990000);
+    g_assert_cmpint(p, <=, 990000 + 990000 / HIST_SUB_BUCKETS);
+
+    g_assert_cmpint(histogram_percentile(&h, 100.0), ==, 1000000);
+
+    /* negative values are counted as underflow */
+    histogram_add(&h, -5);
+    g_assert_cmpint(h.underflow, ==, 1);
+    g_assert_cmpint(h.min, ==, -5);
+    g_assert_cmpint(histogram_percentile(&h, 0.01), ==, -5);
+}
+
+static void test_histogram_merge(void)
+{
+    struct histogram a;
+    struct histogram b;
+
+    histogram_init(&a);
+    histogram_init(&b);
+    histogram_add(&a, 10);
+    histogram_add(&b, 20);
+    histogram_add(&b, 30);
+
+    histogram_merge(&a, &b);
+    g_assert_cmpint(a.count, ==, 3);
+    g_assert_cmpint(a.min, ==, 10);
+    g_assert_cmpint(a.max, ==, 30);
+    g_assert_cmpint(a.sum, ==, 60);
+}
+
+int main(int argc, char** argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/histogram/bucket",
+            test_histogram_bucket);
+
+    g_test_add_func("/histogram/percentile",
+            test_histogram_percentile);
+
+    g_test_add_func("/histogram/merge",
+            test_histogram_merge);
+
+    return g_test_run();
+}
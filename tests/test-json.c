@@ -24,19 +24,67 @@ static void test_json_error(void)
 
 	result.dropped = 0;
 	result.seq_error = FALSE;
-	j = json_error(&result);
+	result.sender_overrun = 0;
+	result.local_overflow = 0;
+	result.network_loss = 0;
+	j = json_error(1, &result);
     g_assert(j != NULL);
     s = json_dumps(j, JSON_COMPACT);
-    g_assert_cmpstr(s, ==, "{\"type\":\"rx-error\",\"object\":{\"dropped-packets\":0,\"sequence-error\":false}}");
+    g_assert_cmpstr(s, ==, "{\"type\":\"rx-error\",\"object\":{\"stream-id\":1,\"dropped-packets\":0,\"sequence-error\":false,\"sender-overrun\":0,\"local-overflow\":0,\"network-loss\":0}}");
     free(s);
     json_decref(j);
 
 	result.dropped = 100;
 	result.seq_error = TRUE;
-	j = json_error(&result);
+	result.sender_overrun = 10;
+	result.local_overflow = 30;
+	result.network_loss = 60;
+	j = json_error(1, &result);
     g_assert(j != NULL);
     s = json_dumps(j, JSON_COMPACT);
-    g_assert_cmpstr(s, ==, "{\"type\":\"rx-error\",\"object\":{\"dropped-packets\":100,\"sequence-error\":true}}");
+    g_assert_cmpstr(s, ==, "{\"type\":\"rx-error\",\"object\":{\"stream-id\":1,\"dropped-packets\":100,\"sequence-error\":true,\"sender-overrun\":10,\"local-overflow\":30,\"network-loss\":60}}");
+    free(s);
+    json_decref(j);
+}
+
+static void test_json_overrun(void)
+{
+	struct ether_testpacket tp;
+	struct timespec ts;
+	json_t *j;
+    char *s;
+
+	memset(&tp, 0, sizeof(tp));
+	tp.stream_id = 2;
+	tp.seq = 41;
+	tp.flags = TP_FLAG_OVERRUN_MARKER | (3 << TP_OVERRUN_SHIFT);
+	ts.tv_sec = 1520944655;
+	ts.tv_nsec = 5000000;
+	memcpy(&tp.timestamps[TS_T0], &ts, sizeof(ts));
+	ts.tv_nsec = 8100000;
+	memcpy(&tp.timestamps[TS_WAKEUP], &ts, sizeof(ts));
+
+	j = json_overrun(&tp);
+    g_assert(j != NULL);
+    s = json_dumps(j, JSON_COMPACT);
+    g_assert_cmpstr(s, ==, "{\"type\":\"tx-overrun\",\"object\":{\"stream-id\":2,\"sequence-number\":41,\"missed-intervals\":3,\"interval-start\":\"2018-03-13T12:37:35.005000000\",\"tx-wakeup\":\"2018-03-13T12:37:35.008100000\"}}");
+    free(s);
+    json_decref(j);
+}
+
+static void test_json_socket_stats(void)
+{
+	struct socket_stats stats;
+	json_t *j;
+    char *s;
+
+	stats.packets = 1000;
+	stats.drops = 3;
+	stats.freeze_q_cnt = 0;
+	j = json_socket_stats(&stats);
+    g_assert(j != NULL);
+    s = json_dumps(j, JSON_COMPACT);
+    g_assert_cmpstr(s, ==, "{\"type\":\"rx-socket-stats\",\"object\":{\"packets\":1000,\"drops\":3,\"freeze-queue-count\":0}}");
     free(s);
     json_decref(j);
 }
@@ -56,7 +104,142 @@ static void test_json_test_packet(void)
 	j = json_test_packet(&tp1, &tp2, tss);
     g_assert(j != NULL);
     s = json_dumps(j, JSON_COMPACT);
-    g_assert_cmpstr(s, ==, "{\"type\":\"rx-packet\",\"object\":{\"stream-id\":0,\"sequence-number\":0,\"interval-usec\":0,\"offset-usec\":0,\"timestamps\":{\"names\":[\"interval-start\",\"tx-wakeup\",\"tx-program\",\"tx-kernel-netsched\",\"tx-kernel-hardware\",\"rx-hardware\",\"rx-program\"],\"values\":[\"1970-01-01T00:00:00.000000000\",\"1970-01-01T00:00:00.000000000\",\"1970-01-01T00:00:00.000000000\",\"1970-01-01T00:00:00.000000000\",\"1970-01-01T00:00:00.000000000\",\"1970-01-01T00:00:00.000000000\",\"1970-01-01T00:00:00.000000000\"]}}}");
+    g_assert_cmpstr(s, ==, "{\"type\":\"rx-packet\",\"object\":{\"stream-id\":0,\"sequence-number\":0,\"interval-usec\":0,\"offset-usec\":0,\"timestamps\":{\"names\":[\"interval-start\",\"tx-wakeup\",\"tx-program\",\"tx-kernel-netsched\",\"tx-kernel-hardware\",\"rx-hardware\",\"rx-kernel-driver\",\"rx-program\"],\"values\":[\"1970-01-01T00:00:00.000000000\",\"1970-01-01T00:00:00.000000000\",\"1970-01-01T00:00:00.000000000\",\"1970-01-01T00:00:00.000000000\",\"1970-01-01T00:00:00.000000000\",\"1970-01-01T00:00:00.000000000\",\"1970-01-01T00:00:00.000000000\",\"1970-01-01T00:00:00.000000000\"]}}}");
+    free(s);
+    json_decref(j);
+}
+
+static void test_json_decomposition(void)
+{
+    json_t *j;
+    char *s;
+    struct decomposition d;
+
+    memset(&d, 0, sizeof(d));
+    d.stream_id = 1;
+    d.seq = 7;
+    d.delta[STAGE_WAKEUP_T0] = 1500;
+    d.valid[STAGE_WAKEUP_T0] = TRUE;
+    d.delta[STAGE_WIRE] = -20;
+    d.valid[STAGE_WIRE] = TRUE;
+
+    j = json_decomposition(&d);
+    g_assert(j != NULL);
+    s = json_dumps(j, JSON_COMPACT);
+    g_assert_cmpstr(s, ==, "{\"type\":\"rx-decomposition\",\"object\":{\"stream-id\":1,\"sequence-number\":7,\"stages-ns\":{\"wakeup-t0\":1500,\"program-wakeup\":null,\"netsched-program\":null,\"driver-netsched\":null,\"wire\":-20,\"rx-sw-hw\":null,\"rx-program-sw\":null}}}");
+    free(s);
+    json_decref(j);
+}
+
+static void test_json_self_stats(void)
+{
+    json_t *j;
+    char *s;
+    struct self_stats stats;
+    int i;
+
+    memset(&stats, 0, sizeof(stats));
+    for (i = 0; i < MAX_SELF_STAGE; i++) {
+        histogram_init(&stats.stages[i]);
+    }
+    histogram_add(&stats.stages[SELF_WRITE], 10);
+
+    stats.interval_ns = 2000000000;
+    stats.packets = 1000;
+    stats.utime_usec = 15000;
+    stats.stime_usec = 5000;
+    stats.max_rss_kb = 4096;
+
+    j = json_self_stats(&stats);
+    g_assert(j != NULL);
+    s = json_dumps(j, JSON_COMPACT);
+    g_assert_cmpstr(s, ==, "{\"type\":\"rx-self\",\"object\":{\"interval-ns\":2000000000,\"packets\":1000,\"packets-per-sec\":500.0,\"cpu-user-usec\":15000,\"cpu-system-usec\":5000,\"cpu-percent\":1.0,\"cpu-ns-per-packet\":20000,\"max-rss-kb\":4096,\"stages-ns\":{\"analysis\":{\"p50\":0,\"p99\":0,\"p99.9\":0,\"max\":0},\"format\":{\"p50\":0,\"p99\":0,\"p99.9\":0,\"max\":0},\"write\":{\"p50\":10,\"p99\":10,\"p99.9\":10,\"max\":10},\"total\":{\"p50\":0,\"p99\":0,\"p99.9\":0,\"max\":0}}}}");
+    free(s);
+    json_decref(j);
+}
+
+static void test_json_summary(void)
+{
+    json_t *j;
+    char *s;
+    struct rx_summary summary;
+
+    memset(&summary, 0, sizeof(summary));
+    histogram_init(&summary.latency);
+    histogram_add(&summary.latency, 10);
+
+    summary.interval_ns = 1000000000;
+    summary.packets = 1000;
+    summary.dropped = 2;
+    summary.events = 1;
+    summary.suppressed = 3;
+
+    j = json_summary(1, &summary);
+    g_assert(j != NULL);
+    s = json_dumps(j, JSON_COMPACT);
+    g_assert_cmpstr(s, ==, "{\"type\":\"rx-summary\",\"object\":{\"stream-id\":1,\"interval-ns\":1000000000,\"packets\":1000,\"dropped-packets\":2,\"sequence-errors\":0,\"events\":1,\"suppressed-events\":3,\"latency-ns\":{\"count\":1,\"min\":10,\"p50\":10,\"p99\":10,\"p99.9\":10,\"max\":10}}}");
+    free(s);
+    json_decref(j);
+}
+
+static void test_json_breaktrace(void)
+{
+    struct ether_testpacket tp;
+    json_t *j;
+    char *s;
+
+    memset(&tp, 0, sizeof(tp));
+    tp.stream_id = 2;
+    tp.seq = 42;
+
+    j = json_breaktrace(&tp, 150000, 100000);
+    g_assert(j != NULL);
+    s = json_dumps(j, JSON_COMPACT);
+    g_assert_cmpstr(s, ==, "{\"type\":\"rx-breaktrace\",\"object\":{\"stream-id\":2,\"sequence-number\":42,\"latency-ns\":150000,\"threshold-ns\":100000}}");
+    free(s);
+    json_decref(j);
+}
+
+static void test_json_clock(void)
+{
+    struct skew sk;
+    json_t *j;
+    char *s;
+    gint64 corrected = 900;
+
+    skew_init(&sk, 1000);
+    skew_add(&sk, 0, 100);
+    skew_add(&sk, 1000, 200);
+    skew_add(&sk, 2000, 200);
+
+    j = json_clock(3, &sk);
+    g_assert(j != NULL);
+    s = json_dumps(j, JSON_COMPACT);
+    g_assert_cmpstr(s, ==, "{\"type\":\"rx-clock\",\"object\":{\"stream-id\":3,\"windows\":2,\"window-min-ns\":200,\"envelope-ns\":200,\"wander-ns\":100,\"drift-ppm\":100000.0,\"residual-ns\":0}}");
+    free(s);
+    json_decref(j);
+
+    j = json_pack("{sss{}}", "type", "rx-packet", "object");
+    json_add_latency(j, 1000, NULL);
+    s = json_dumps(j, JSON_COMPACT);
+    g_assert_cmpstr(s, ==, "{\"type\":\"rx-packet\",\"object\":{\"latency-ns\":1000,\"latency-corrected-ns\":null}}");
+    free(s);
+    json_add_latency(j, 1000, &corrected);
+    s = json_dumps(j, JSON_COMPACT);
+    g_assert_cmpstr(s, ==, "{\"type\":\"rx-packet\",\"object\":{\"latency-ns\":1000,\"latency-corrected-ns\":900}}");
+    free(s);
+    json_decref(j);
+}
+
+static void test_json_reflect(void)
+{
+    json_t *j;
+    char *s;
+
+    j = json_reflect(1000, 3, 1);
+    g_assert(j != NULL);
+    s = json_dumps(j, JSON_COMPACT);
+    g_assert_cmpstr(s, ==, "{\"type\":\"rx-reflect\",\"object\":{\"reflected\":1000,\"ignored\":3,\"send-errors\":1}}");
     free(s);
     json_decref(j);
 }
@@ -67,6 +250,29 @@ int main(int argc, char** argv)
 
 	g_test_add_func("/timer/test_json_error",
 			test_json_error);
+	g_test_add_func("/timer/test_json_overrun",
+			test_json_overrun);
+
+	g_test_add_func("/timer/test_json_socket_stats",
+			test_json_socket_stats);
+
+	g_test_add_func("/timer/test_json_decomposition",
+			test_json_decomposition);
+
+	g_test_add_func("/timer/test_json_self_stats",
+			test_json_self_stats);
+
+	g_test_add_func("/timer/test_json_summary",
+			test_json_summary);
+
+	g_test_add_func("/timer/test_json_breaktrace",
+			test_json_breaktrace);
+
+	g_test_add_func("/timer/test_json_clock",
+			test_json_clock);
+
+	g_test_add_func("/timer/test_json_reflect",
+			test_json_reflect);
 
 	g_test_add_func("/timer/test_json_test_packet",
 			test_json_test_packet);
@@ -0,0 +1,210 @@
+/*
+ *  (C) Copyright 2021 Kontron Europe GmbH, Saarbruecken
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include <glib.h>
+
+#include "../packet.c"
+
+
+static void fill_packet(struct ether_testpacket *tp, guint8 version)
+{
+    int i;
+
+    memset(tp, 0, sizeof(*tp));
+    memset(tp->hdr.ether_dhost, 0xff, ETH_ALEN);
+    tp->hdr.ether_type = htons(TP_ETHER_TYPE);
+    tp->version = version;
+    tp->stream_id = 3;
+    tp->seq = 0x100000002ULL;
+    tp->interval_usec = 1000000;
+    tp->offset_usec = -250;
+    tp->flags = TP_FLAG_LATE | (2 << TP_OVERRUN_SHIFT);
+    for (i = 0; i < TS_MAX_NUM; i++) {
+        tp->timestamps[i].tv_sec = 1520944655 + i;
+        tp->timestamps[i].tv_nsec = 5000000 + i;
+    }
+}
+
+/*
+ * TESTS
+ */
+static void test_v2_roundtrip(void)
+{
+    struct ether_testpacket tp;
+    struct ether_testpacket out;
+    struct ether_testpacket_v2 *v2;
+    char frame[128];
+    int i;
+
+    fill_packet(&tp, TP_VERSION_2);
+    memset(&tp.timestamps[TS_LAST_KERNEL_SCHED], 0, sizeof(struct timespec));
+
+    g_assert_cmpint(tp_encode(&tp, TS_MAX_NUM, frame, sizeof(frame)), ==,
+            TP_V2_LEN(TS_MAX_NUM));
+    g_assert_cmpint(TP_V2_LEN(TS_MAX_NUM), <, TP_LEN(TS_MAX_NUM));
+
+    /* the wire format is little-endian */
+    v2 = (void *)frame;
+    g_assert_cmpint(((guint8 *)&v2->seq)[0], ==, 2);
+    g_assert_cmpint(((guint8 *)&v2->seq)[4], ==, 1);
+    g_assert_cmpint(((guint8 *)&v2->interval_ns)[0], ==, 0x00);
+    g_assert_cmpint(((guint8 *)&v2->interval_ns)[3], ==, 0x3b);
+
+    g_assert_cmpint(tp_decode(frame, TP_V2_LEN(TS_MAX_NUM), &out), ==, 0);
+    g_assert_cmpint(out.version, ==, TP_VERSION_2);
+    g_assert_cmpint(out.stream_id, ==, 3);
+    g_assert_cmpuint(out.seq, ==, 0x100000002ULL);
+    g_assert_cmpint(out.interval_usec, ==, 1000000);
+    g_assert_cmpint(out.offset_usec, ==, -250);
+    g_assert_cmpint(TP_OVERRUNS(out.flags), ==, 2);
+    g_assert_cmpmem(&out.hdr, sizeof(out.hdr), &tp.hdr, sizeof(tp.hdr));
+    for (i = 0; i < TS_MAX_NUM; i++) {
+        g_assert_cmpint(out.timestamps[i].tv_sec, ==,
+                tp.timestamps[i].tv_sec);
+        g_assert_cmpint(out.timestamps[i].tv_nsec, ==,
+                tp.timestamps[i].tv_nsec);
+    }
+
+    /* a small frame, the missing timestamps are zero */
+    g_assert_cmpint(tp_encode(&tp, 1, frame, sizeof(frame)), ==,
+            TP_V2_LEN(1));
+    g_assert_cmpint(tp_decode(frame, TP_V2_LEN(1), &out), ==, 0);
+    g_assert_cmpint(out.timestamps[TS_T0].tv_sec, ==, 1520944655);
+    g_assert_cmpint(out.timestamps[TS_WAKEUP].tv_sec, ==, 0);
+}
+
+static void test_v1_compat(void)
+{
+    struct ether_testpacket tp;
+    struct ether_testpacket out;
+    struct ether_testpacket_v1 *v1;
+    char frame[256];
+
+    fill_packet(&tp, TP_VERSION_1);
+    tp.interval_usec = 1000;
+
+    g_assert_cmpint(tp_encode(&tp, 5, frame, sizeof(frame)), ==, TP_LEN(5));
+
+    /* the layout of earlier versions */
+    v1 = (void *)frame;
+    g_assert_cmpint(v1->version, ==, 1);
+    g_assert_cmpint(v1->seq, ==, 2);
+    g_assert_cmpint(v1->interval_usec, ==, 1000);
+    g_assert_cmpint(TP_HDR_LEN, ==, 28);
+
+    g_assert_cmpint(tp_decode(frame, TP_LEN(5), &out), ==, 0);
+    g_assert_cmpuint(out.seq, ==, 2);
+    g_assert_cmpint(out.interval_usec, ==, 1000);
+    g_assert_cmpint(out.flags, ==, tp.flags);
+    g_assert_cmpint(out.timestamps[4].tv_nsec, ==, 5000004);
+    g_assert_cmpint(out.timestamps[5].tv_nsec, ==, 0);
+
+    /* padding after the timestamps is ignored */
+    memset(frame + TP_LEN(5), 0, TP_LEN(TS_MAX_NUM) + 16 - TP_LEN(5));
+    g_assert_cmpint(tp_decode(frame, TP_LEN(TS_MAX_NUM) + 16, &out), ==, 0);
+    g_assert_cmpint(out.timestamps[5].tv_nsec, ==, 0);
+}
+
+static void test_invalid(void)
+{
+    struct ether_testpacket tp;
+    char frame[128];
+
+    fill_packet(&tp, 3);
+    g_assert_cmpint(tp_encode(&tp, 1, frame, sizeof(frame)), ==, -1);
+
+    fill_packet(&tp, TP_VERSION_2);
+    g_assert_cmpint(tp_encode(&tp, TS_MAX_NUM, frame, 20), ==, -1);
+
+    /* the offset does not fit the 32 bit nsec field of v2 */
+    tp.offset_usec = -2200000;
+    g_assert_cmpint(tp_encode(&tp, 1, frame, sizeof(frame)), ==, -1);
+    tp.interval_usec = 5000000;
+    tp.offset_usec = 0;
+    g_assert_cmpint(tp_encode(&tp, 1, frame, sizeof(frame)), ==, -1);
+    tp.interval_usec = 1000000;
+
+    tp_encode(&tp, 1, frame, sizeof(frame));
+    frame[offsetof(struct ether_testpacket_v2, version)] = 7;
+    g_assert_cmpint(tp_decode(frame, TP_V2_LEN(1), &tp), ==, -1);
+    g_assert_cmpint(tp_decode(frame, 10, &tp), ==, -1);
+}
+
+static void test_reflect(void)
+{
+    static const guint8 own[ETH_ALEN] = { 0x02, 0, 0, 0, 0, 0x42 };
+    static const guint8 sender[ETH_ALEN] = { 0x02, 0, 0, 0, 0, 0x01 };
+    struct timespec rx_ts = { 1520944700, 100 };
+    struct timespec tx_ts = { 1520944700, 2100 };
+    struct ether_testpacket tp;
+    struct ether_testpacket out;
+    char frame[128];
+    gssize len;
+
+    /* a small v2 frame is extended by the reflector timestamps */
+    fill_packet(&tp, TP_VERSION_2);
+    memcpy(tp.hdr.ether_shost, sender, ETH_ALEN);
+    len = tp_encode(&tp, 1, frame, sizeof(frame));
+    memset(frame + len, 0xaa, sizeof(frame) - len);
+
+    len = tp_reflect(frame, len, sizeof(frame), own, &rx_ts);
+    g_assert_cmpint(len, ==, TP_V2_LEN(TS_REFLECT_TX + 1));
+    tp_reflect_set_tx(frame, &tx_ts);
+
+    g_assert_cmpint(tp_decode(frame, len, &out), ==, 0);
+    g_assert_cmpmem(out.hdr.ether_dhost, ETH_ALEN, sender, ETH_ALEN);
+    g_assert_cmpmem(out.hdr.ether_shost, ETH_ALEN, own, ETH_ALEN);
+    g_assert_cmpint(out.flags, ==, tp.flags | TP_FLAG_REFLECTED);
+    g_assert_cmpuint(out.seq, ==, tp.seq);
+    g_assert_cmpint(out.timestamps[TS_T0].tv_sec, ==, 1520944655);
+    g_assert_cmpint(out.timestamps[TS_WAKEUP].tv_sec, ==, 0);
+    g_assert_cmpint(out.timestamps[TS_PROG_SEND].tv_sec, ==, 0);
+    g_assert_cmpint(out.timestamps[TS_REFLECT_RX].tv_nsec, ==, 100);
+    g_assert_cmpint(out.timestamps[TS_REFLECT_TX].tv_nsec, ==, 2100);
+
+    /* reflections are not reflected again */
+    g_assert_cmpint(tp_reflect(frame, len, sizeof(frame), own, &rx_ts), ==,
+            -1);
+
+    /* a full v1 frame keeps its length and the sender timestamps */
+    fill_packet(&tp, TP_VERSION_1);
+    len = tp_encode(&tp, 5, frame, sizeof(frame));
+    g_assert_cmpint(tp_reflect(frame, len, sizeof(frame), own, &rx_ts), ==,
+            TP_LEN(5));
+    tp_reflect_set_tx(frame, &tx_ts);
+    g_assert_cmpint(tp_decode(frame, len, &out), ==, 0);
+    g_assert_cmpint(out.flags, ==, tp.flags | TP_FLAG_REFLECTED);
+    g_assert_cmpint(out.timestamps[TS_PROG_SEND].tv_nsec, ==, 5000002);
+    g_assert_cmpint(out.timestamps[TS_REFLECT_RX].tv_sec, ==, 1520944700);
+    g_assert_cmpint(out.timestamps[TS_REFLECT_TX].tv_nsec, ==, 2100);
+
+    /* follow-ups and frames which do not fit are not reflected */
+    fill_packet(&tp, TP_VERSION_1);
+    tp.flags |= TP_FLAG_FOLLOW_UP;
+    len = tp_encode(&tp, 5, frame, sizeof(frame));
+    g_assert_cmpint(tp_reflect(frame, len, sizeof(frame), own, &rx_ts), ==,
+            -1);
+    tp.flags &= ~TP_FLAG_FOLLOW_UP;
+    len = tp_encode(&tp, 1, frame, sizeof(frame));
+    g_assert_cmpint(tp_reflect(frame, len, len, own, &rx_ts), ==, -1);
+    g_assert_cmpint(tp_reflect(frame, 10, sizeof(frame), own, &rx_ts), ==,
+            -1);
+}
+
+int main(int argc, char** argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/packet/v2_roundtrip", test_v2_roundtrip);
+    g_test_add_func("/packet/v1_compat", test_v1_compat);
+    g_test_add_func("/packet/invalid", test_invalid);
+    g_test_add_func("/packet/reflect", test_reflect);
+
+    return g_test_run();
+}
@@ -0,0 +1,94 @@
+/*
+ *  (C) Copyright 2021 Kontron Europe GmbH, Saarbruecken
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <libgen.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "../pcapng.c"
+
+
+/*
+ * TESTS
+ */
+static void test_write_read(void)
+{
+    struct pcapng_file *f;
+    struct timespec tss[MAX_TS_RX];
+    guint8 frame[61];
+    guint8 buf[128];
+    guint32 len;
+    gchar *path;
+    int i;
+
+    path = g_strdup_printf("/tmp/nl-test-pcapng-%d", getpid());
+
+    for (i = 0; i < (int)sizeof(frame); i++) {
+        frame[i] = i;
+    }
+
+    f = pcapng_create(path);
+    g_assert(f != NULL);
+
+    memset(tss, 0, sizeof(tss));
+    tss[TS_KERNEL_HW_RX].tv_sec = 100;
+    tss[TS_KERNEL_HW_RX].tv_nsec = 1;
+    tss[TS_PROG_RECV].tv_sec = 101;
+    tss[TS_PROG_RECV].tv_nsec = 999999999;
+    g_assert_cmpint(pcapng_write_packet(f, frame, sizeof(frame), tss), ==, 0);
+
+    memset(tss, 0, sizeof(tss));
+    tss[TS_KERNEL_SW_RX].tv_sec = 200;
+    g_assert_cmpint(pcapng_write_packet(f, frame, 14, tss), ==, 0);
+    pcapng_close(f);
+
+    f = pcapng_open(path);
+    g_assert(f != NULL);
+
+    g_assert_cmpint(pcapng_read_packet(f, buf, sizeof(buf), &len, tss), ==, 1);
+    g_assert_cmpint(len, ==, sizeof(frame));
+    g_assert_cmpmem(buf, len, frame, sizeof(frame));
+    g_assert_cmpint(tss[TS_KERNEL_HW_RX].tv_sec, ==, 100);
+    g_assert_cmpint(tss[TS_KERNEL_HW_RX].tv_nsec, ==, 1);
+    g_assert_cmpint(tss[TS_KERNEL_SW_RX].tv_sec, ==, 0);
+    g_assert_cmpint(tss[TS_PROG_RECV].tv_sec, ==, 101);
+    g_assert_cmpint(tss[TS_PROG_RECV].tv_nsec, ==, 999999999);
+
+    /* frames are truncated to the buffer size */
+    g_assert_cmpint(pcapng_read_packet(f, buf, 10, &len, tss), ==, 1);
+    g_assert_cmpint(len, ==, 10);
+    g_assert_cmpint(tss[TS_KERNEL_SW_RX].tv_sec, ==, 200);
+    g_assert_cmpint(tss[TS_KERNEL_HW_RX].tv_sec, ==, 0);
+
+    g_assert_cmpint(pcapng_read_packet(f, buf, sizeof(buf), &len, tss), ==, 0);
+    pcapng_close(f);
+
+    g_unlink(path);
+    g_free(path);
+}
+
+static void test_tsresol(void)
+{
+    g_assert_cmpuint(tsresol_to_ts_per_sec(6), ==, 1000000);
+    g_assert_cmpuint(tsresol_to_ts_per_sec(9), ==, 1000000000);
+    g_assert_cmpuint(tsresol_to_ts_per_sec(0x80 | 10), ==, 1024);
+}
+
+int main(int argc, char** argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/pcapng/write_read",
+            test_write_read);
+
+    g_test_add_func("/pcapng/tsresol",
+            test_tsresol);
+
+    return g_test_run();
+}
@@ -0,0 +1,191 @@
+/*
+ *  (C) Copyright 2021 Kontron Europe GmbH, Saarbruecken
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <libgen.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "../recorder.c"
+
+
+static gchar **read_lines(const gchar *path)
+{
+    gchar *contents;
+    gchar **lines;
+
+    g_assert(g_file_get_contents(path, &contents, NULL, NULL));
+    lines = g_strsplit(contents, "\n", -1);
+    g_free(contents);
+
+    return lines;
+}
+
+static gboolean is_event(const gchar *line)
+{
+    json_t *j = json_loads(line, 0, NULL);
+    gboolean rc;
+
+    rc = j && !g_strcmp0(json_string_value(json_object_get(j, "type")),
+            "rx-event");
+    json_decref(j);
+
+    return rc;
+}
+
+static json_t *trigger_info(void)
+{
+    return json_pack("{ss}", "reason", "latency");
+}
+
+/*
+ * TESTS
+ */
+static void test_ring(void)
+{
+    struct recorder *r;
+    gchar *path;
+    gchar **lines;
+    json_t *j;
+
+    path = g_strdup_printf("/tmp/nl-test-recorder-%d", getpid());
+
+    r = recorder_new(path, 2, 3, 2, 1000);
+    g_assert(r != NULL);
+
+    /* only the last three records of stream 0 are kept */
+    recorder_add(r, 0, "a");
+    recorder_add(r, 1, "x");
+    recorder_add(r, 0, "b");
+    recorder_add(r, 0, "c");
+    recorder_add(r, 0, "d");
+    g_assert_cmpuint(recorder_trigger(r, 0, 0, trigger_info()), ==, 1);
+
+    /* the next two records follow, then the ring fills again */
+    recorder_add(r, 0, "e");
+    recorder_add(r, 1, "y");
+    recorder_add(r, 0, "f");
+    recorder_add(r, 0, "g");
+    recorder_free(r);
+
+    lines = read_lines(path);
+    g_assert_cmpuint(g_strv_length(lines), ==, 7);
+
+    j = json_loads(lines[0], 0, NULL);
+    g_assert(j != NULL);
+    g_assert_cmpstr(json_string_value(json_object_get(j, "type")), ==,
+            "rx-event");
+    g_assert_cmpint(json_integer_value(json_object_get(
+            json_object_get(j, "object"), "event-id")), ==, 1);
+    g_assert_cmpint(json_integer_value(json_object_get(
+            json_object_get(j, "object"), "pre-records")), ==, 3);
+    g_assert_cmpstr(json_string_value(json_object_get(
+            json_object_get(j, "object"), "reason")), ==, "latency");
+    json_decref(j);
+
+    g_assert_cmpstr(lines[1], ==, "b");
+    g_assert_cmpstr(lines[2], ==, "c");
+    g_assert_cmpstr(lines[3], ==, "d");
+    g_assert_cmpstr(lines[4], ==, "e");
+    g_assert_cmpstr(lines[5], ==, "f");
+    g_assert_cmpstr(lines[6], ==, "");
+
+    g_strfreev(lines);
+    g_unlink(path);
+    g_free(path);
+}
+
+static void test_holdoff(void)
+{
+    struct recorder *r;
+    guint64 events, suppressed;
+    gchar *path;
+    gchar **lines;
+
+    path = g_strdup_printf("/tmp/nl-test-recorder-%d", getpid());
+
+    r = recorder_new(path, 2, 2, 1, 1000);
+    g_assert(r != NULL);
+
+    recorder_add(r, 0, "a");
+    g_assert_cmpuint(recorder_trigger(r, 0, 100, trigger_info()), ==, 1);
+
+    /* a trigger of the running event does not count as suppressed */
+    g_assert_cmpuint(recorder_trigger(r, 0, 200, trigger_info()), ==, 0);
+    recorder_add(r, 0, "b");
+
+    /* within the holdoff time */
+    recorder_add(r, 0, "c");
+    g_assert_cmpuint(recorder_trigger(r, 0, 1099, trigger_info()), ==, 0);
+
+    /* the holdoff is per stream, event ids are global */
+    g_assert_cmpuint(recorder_trigger(r, 1, 1099, trigger_info()), ==, 2);
+
+    recorder_add(r, 0, "d");
+    g_assert_cmpuint(recorder_trigger(r, 0, 1100, trigger_info()), ==, 3);
+
+    recorder_stream_stats(r, 0, &events, &suppressed);
+    g_assert_cmpuint(events, ==, 2);
+    g_assert_cmpuint(suppressed, ==, 1);
+    recorder_stream_stats(r, 1, &events, &suppressed);
+    g_assert_cmpuint(events, ==, 1);
+    g_assert_cmpuint(suppressed, ==, 0);
+    recorder_free(r);
+
+    /* event 1, a, b, event 2, event 3, c, d */
+    lines = read_lines(path);
+    g_assert_cmpuint(g_strv_length(lines), ==, 8);
+    g_assert(is_event(lines[0]));
+    g_assert_cmpstr(lines[1], ==, "a");
+    g_assert_cmpstr(lines[2], ==, "b");
+    g_assert(is_event(lines[3]));
+    g_assert(is_event(lines[4]));
+    g_assert_cmpstr(lines[5], ==, "c");
+    g_assert_cmpstr(lines[6], ==, "d");
+
+    g_strfreev(lines);
+    g_unlink(path);
+    g_free(path);
+}
+
+static void test_no_pre(void)
+{
+    struct recorder *r;
+    gchar *path;
+    gchar **lines;
+
+    path = g_strdup_printf("/tmp/nl-test-recorder-%d", getpid());
+
+    r = recorder_new(path, 1, 0, 1, 0);
+    g_assert(r != NULL);
+
+    recorder_add(r, 0, "a");
+    g_assert_cmpuint(recorder_trigger(r, 0, 0, trigger_info()), ==, 1);
+    recorder_add(r, 0, "b");
+    recorder_add(r, 0, "c");
+    recorder_free(r);
+
+    lines = read_lines(path);
+    g_assert_cmpuint(g_strv_length(lines), ==, 3);
+    g_assert_cmpstr(lines[1], ==, "b");
+
+    g_strfreev(lines);
+    g_unlink(path);
+    g_free(path);
+}
+
+int main(int argc, char** argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/recorder/ring", test_ring);
+    g_test_add_func("/recorder/holdoff", test_holdoff);
+    g_test_add_func("/recorder/no_pre", test_no_pre);
+
+    return g_test_run();
+}
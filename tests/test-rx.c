@@ -146,6 +146,265 @@ static void test_is_broadcast_addr(void)
     g_assert_false(is_broadcast_addr(addr));
 }
 
+static void test_decompose_latency(void)
+{
+    struct ether_testpacket tp;
+    struct ether_testpacket fu;
+    struct timespec tss[MAX_TS_RX];
+    struct timespec ts;
+    struct decomposition d;
+
+    memset(&tp, 0, sizeof(tp));
+    memset(&fu, 0, sizeof(fu));
+    memset(tss, 0, sizeof(tss));
+
+    tp.seq = 3;
+    ts.tv_sec = 10;
+    ts.tv_nsec = 0;
+    memcpy(&tp.timestamps[TS_T0], &ts, sizeof(ts));
+    ts.tv_nsec = 1000;
+    memcpy(&tp.timestamps[TS_WAKEUP], &ts, sizeof(ts));
+    ts.tv_nsec = 1500;
+    memcpy(&tp.timestamps[TS_PROG_SEND], &ts, sizeof(ts));
+    ts.tv_nsec = 4000;
+    memcpy(&fu.timestamps[TS_LAST_KERNEL_SCHED], &ts, sizeof(ts));
+    ts.tv_nsec = 9000;
+    memcpy(&fu.timestamps[TS_LAST_KERNEL_SW_TX], &ts, sizeof(ts));
+    ts.tv_nsec = 12000;
+    memcpy(&fu.timestamps[TS_LAST_KERNEL_HW_TX], &ts, sizeof(ts));
+
+    tss[TS_KERNEL_HW_RX].tv_sec = 10;
+    tss[TS_KERNEL_HW_RX].tv_nsec = 20000;
+    tss[TS_PROG_RECV].tv_sec = 10;
+    tss[TS_PROG_RECV].tv_nsec = 50000;
+
+    /* the hardware TX timestamp is only used from follow-up frames */
+    decompose_latency(&tp, &fu, tss, &d);
+    g_assert_cmpint(d.seq, ==, 3);
+    g_assert_true(d.valid[STAGE_WAKEUP_T0]);
+    g_assert_cmpint(d.delta[STAGE_WAKEUP_T0], ==, 1000);
+    g_assert_cmpint(d.delta[STAGE_PROGRAM_WAKEUP], ==, 500);
+    g_assert_cmpint(d.delta[STAGE_NETSCHED_PROGRAM], ==, 2500);
+    g_assert_cmpint(d.delta[STAGE_DRIVER_NETSCHED], ==, 5000);
+    g_assert_false(d.valid[STAGE_WIRE]);
+    g_assert_false(d.valid[STAGE_RX_SW_HW]);
+    g_assert_false(d.valid[STAGE_RX_PROGRAM_SW]);
+
+    fu.flags = TP_FLAG_FOLLOW_UP;
+    tss[TS_KERNEL_SW_RX].tv_sec = 10;
+    tss[TS_KERNEL_SW_RX].tv_nsec = 30000;
+    decompose_latency(&tp, &fu, tss, &d);
+    g_assert_true(d.valid[STAGE_WIRE]);
+    g_assert_cmpint(d.delta[STAGE_WIRE], ==, 8000);
+    g_assert_cmpint(d.delta[STAGE_RX_SW_HW], ==, 10000);
+    g_assert_cmpint(d.delta[STAGE_RX_PROGRAM_SW], ==, 20000);
+
+    /* only the interval start is sent in small packet mode */
+    tp.flags = TP_FLAG_SMALL_MODE;
+    decompose_latency(&tp, &fu, tss, &d);
+    g_assert_false(d.valid[STAGE_WAKEUP_T0]);
+    g_assert_false(d.valid[STAGE_DRIVER_NETSCHED]);
+}
+
+static void test_replay_pcapng(void)
+{
+    struct pcapng_file *f;
+    struct ether_testpacket tp;
+    char frame[TP_LEN(TS_MAX_NUM)];
+    struct timespec tss[MAX_TS_RX];
+    gchar *path;
+    int i;
+
+    path = g_strdup_printf("/tmp/nl-test-replay-%d", getpid());
+    f = pcapng_create(path);
+    g_assert(f != NULL);
+
+    memset(&tp, 0, sizeof(tp));
+    tp.hdr.ether_type = htons(TP_ETHER_TYPE);
+    tp.version = 1;
+    tp.stream_id = 2;
+
+    for (i = 1; i <= 2; i++) {
+        tp.seq = i;
+        memset(tss, 0, sizeof(tss));
+        tss[TS_KERNEL_HW_RX].tv_sec = i;
+        tss[TS_KERNEL_SW_RX].tv_sec = 10 + i;
+        tss[TS_PROG_RECV].tv_sec = 20 + i;
+        g_assert_cmpint(tp_encode(&tp, TS_MAX_NUM, frame, sizeof(frame)), ==,
+                TP_LEN(TS_MAX_NUM));
+        pcapng_write_packet(f, frame, TP_LEN(TS_MAX_NUM), tss);
+    }
+    pcapng_close(f);
+
+    g_assert_cmpint(replay_pcapng(path), ==, 0);
+
+    /* the timestamps are passed as on a live socket */
+    g_assert_cmpint(results[2].tp->seq, ==, 2);
+    g_assert_cmpint(results[2].last_tp->seq, ==, 1);
+    g_assert_cmpint(results[2].rx_tss[TS_KERNEL_HW_RX].tv_sec, ==, 2);
+    g_assert_cmpint(results[2].rx_tss[TS_KERNEL_SW_RX].tv_sec, ==, 12);
+    g_assert_cmpint(results[2].rx_tss[TS_PROG_RECV].tv_sec, ==, 22);
+    g_assert_cmpint(results[2].dropped, ==, 0);
+
+    g_unlink(path);
+    g_free(path);
+}
+
+static void test_self_stats_pcapng(void)
+{
+    struct ether_testpacket tp;
+    char frame[TP_LEN(TS_MAX_NUM)];
+    struct timespec prog_ts;
+    struct msghdr msg;
+    struct iovec iov;
+    gchar *path;
+    int i;
+
+    path = g_strdup_printf("/tmp/nl-test-self-%d", getpid());
+    pcapng = pcapng_create(path);
+    g_assert(pcapng != NULL);
+    o_self_stats_interval = 1;
+    self_reset();
+
+    memset(&tp, 0, sizeof(tp));
+    tp.hdr.ether_type = htons(TP_ETHER_TYPE);
+    tp.version = 1;
+    tp.stream_id = 3;
+
+    for (i = 1; i <= 100; i++) {
+        tp.seq = i;
+        g_assert_cmpint(tp_encode(&tp, TS_MAX_NUM, frame, sizeof(frame)), ==,
+                TP_LEN(TS_MAX_NUM));
+        iov.iov_base = frame;
+        iov.iov_len = sizeof(frame);
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        clock_gettime(CLOCK_REALTIME, &prog_ts);
+        process_msg(&msg, &prog_ts);
+    }
+
+    /* the pcapng write is only accounted once, as writing */
+    g_assert_cmpint(self_stats.packets, ==, 100);
+    g_assert_cmpint(self_stats.stages[SELF_FORMAT].underflow, ==, 0);
+    g_assert_cmpint(self_stats.stages[SELF_ANALYSIS].underflow, ==, 0);
+    g_assert_cmpint(self_stats.stages[SELF_WRITE].min, >, 0);
+
+    o_self_stats_interval = 0;
+    pcapng_close(pcapng);
+    pcapng = NULL;
+    g_unlink(path);
+    g_free(path);
+}
+
+static void test_attribute_drops(void)
+{
+    struct ether_testpacket tp;
+    struct result r;
+
+    memset(&r, 0, sizeof(r));
+    have_rxq_ovfl = TRUE;
+
+    /* three packets overflowed the socket, the gap is five packets */
+    local_drops_pending = 3;
+    r.dropped = 5;
+    attribute_drops(&r);
+    g_assert_cmpint(r.local_overflow, ==, 3);
+    g_assert_cmpint(r.network_loss, ==, 2);
+    g_assert_cmpint(local_drops_pending, ==, 0);
+
+    /* the remaining socket drops are kept for the next gap */
+    local_drops_pending = 4;
+    r.dropped = 1;
+    attribute_drops(&r);
+    g_assert_cmpint(r.local_overflow, ==, 1);
+    g_assert_cmpint(r.network_loss, ==, 0);
+    g_assert_cmpint(local_drops_pending, ==, 3);
+
+    r.dropped = 0;
+    attribute_drops(&r);
+    g_assert_cmpint(r.local_overflow, ==, 0);
+    g_assert_cmpint(r.network_loss, ==, 0);
+
+    /* the sender reports two missed intervals before this packet */
+    memset(&tp, 0, sizeof(tp));
+    tp.flags = 2 << TP_OVERRUN_SHIFT;
+    r.tp = &tp;
+    local_drops_pending = 1;
+    r.dropped = 4;
+    attribute_drops(&r);
+    g_assert_cmpint(r.sender_overrun, ==, 2);
+    g_assert_cmpint(r.local_overflow, ==, 1);
+    g_assert_cmpint(r.network_loss, ==, 1);
+
+    /* late packets of the sender do not leave a gap */
+    r.dropped = 1;
+    attribute_drops(&r);
+    g_assert_cmpint(r.sender_overrun, ==, 1);
+    g_assert_cmpint(r.network_loss, ==, 0);
+
+    local_drops_pending = 0;
+    have_rxq_ovfl = FALSE;
+}
+
+static void test_follow_up_join(void)
+{
+    struct result *r = &results[0];
+    struct ether_testpacket tp;
+    struct ether_testpacket fu;
+    struct timespec tss[MAX_TS_RX];
+
+    memset(&tp, 0, sizeof(tp));
+    memset(&fu, 0, sizeof(fu));
+    memset(tss, 0, sizeof(tss));
+    r->tp = &tp;
+    r->rx_tss = tss;
+    o_count = 100;
+    count = 0;
+
+    /* test packet and follow-up are joined by sequence number */
+    tp.seq = 5;
+    pending_add_test_packet(r);
+    g_assert_true(r->pending[5].have_tp);
+    g_assert_cmpint(count, ==, 0);
+    fu.seq = 5;
+    fu.flags = TP_FLAG_FOLLOW_UP;
+    pending_add_follow_up(r, &fu);
+    g_assert_false(r->pending[5].have_tp);
+    g_assert_false(r->pending[5].have_fu);
+    g_assert_cmpint(count, ==, 1);
+
+    /* a follow-up may arrive before its test packet */
+    fu.seq = 6;
+    pending_add_follow_up(r, &fu);
+    g_assert_cmpint(count, ==, 1);
+    tp.seq = 6;
+    pending_add_test_packet(r);
+    g_assert_cmpint(count, ==, 2);
+
+    /* a missing follow-up is flushed on timeout */
+    tp.seq = 7;
+    pending_add_test_packet(r);
+    pending_expire(g_get_monotonic_time());
+    g_assert_cmpint(count, ==, 2);
+    pending_expire(G_MAXINT64);
+    g_assert_cmpint(count, ==, 3);
+
+    /* a stale entry is flushed when its slot is reused */
+    tp.seq = 8;
+    pending_add_test_packet(r);
+    tp.seq = 8 + RX_PENDING_WINDOW;
+    pending_add_test_packet(r);
+    g_assert_cmpint(count, ==, 4);
+    g_assert_true(r->pending[8].have_tp);
+
+    g_free(r->pending);
+    memset(r, 0, sizeof(*r));
+    o_count = 0;
+    count = 0;
+    do_shutdown = FALSE;
+}
+
 static void test_dump_json_test_packet(void)
 {
     struct ether_testpacket _tp, *tp = &_tp;
@@ -183,6 +442,17 @@ int main(int argc, char** argv)
     g_test_add_func("/rx/is_broadcast_addr",
            test_is_broadcast_addr);
 
+    g_test_add_func("/rx/decompose_latency",
+            test_decompose_latency);
+    g_test_add_func("/rx/replay_pcapng",
+            test_replay_pcapng);
+    g_test_add_func("/rx/self_stats_pcapng",
+            test_self_stats_pcapng);
+    g_test_add_func("/rx/attribute_drops",
+            test_attribute_drops);
+    g_test_add_func("/rx/follow_up_join",
+            test_follow_up_join);
+
     g_test_add_func("/rx/dump_json_test_packet",
             test_dump_json_test_packet);
 
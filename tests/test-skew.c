@@ -0,0 +1,100 @@
+/*
+ *  (C) Copyright 2021 Kontron Europe GmbH, Saarbruecken
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <libgen.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "../skew.c"
+
+
+/* deterministic queueing delay of 0 to 100 usec */
+static gint64 queueing(guint32 *state)
+{
+    *state = *state * 1103515245 + 12345;
+    return (*state >> 8) % 100000;
+}
+
+/*
+ * TESTS
+ */
+static void test_drift(void)
+{
+    struct skew s;
+    guint32 state = 1;
+    gint64 t;
+
+    skew_init(&s, 100000000);
+
+    /* 1 kHz for 20 s, 20 usec path delay, 5 usec offset, +20 ppm */
+    for (t = 0; t < 20000000000LL; t += 1000000) {
+        gint64 delay = 20000 + 5000 + t / 50000 + queueing(&state);
+        skew_add(&s, 1000000000000LL + t, delay);
+    }
+
+    g_assert(skew_valid(&s));
+    g_assert_cmpfloat(fabs(skew_drift_ppm(&s) - 20.0), <, 0.5);
+    g_assert_cmpint(llabs(skew_envelope(&s, 1000000000000LL + t)
+            - (25000 + t / 50000)), <, 1000);
+    g_assert_cmpint(llabs(skew_correction(&s, 1000000000000LL + t)
+            - t / 50000), <, 1000);
+    g_assert_cmpfloat(s.residual, <, 1000.0);
+}
+
+static void test_step(void)
+{
+    struct skew s;
+    guint32 state = 1;
+    gint64 t;
+
+    skew_init(&s, 100000000);
+
+    /* the clock offset jumps by 50 usec after 10 s */
+    for (t = 0; t < 20000000000LL; t += 1000000) {
+        gint64 delay = 20000 + queueing(&state);
+        if (t >= 10000000000LL) {
+            delay += 50000;
+        }
+        skew_add(&s, t, delay);
+    }
+
+    /* the estimate has followed the step within the horizon */
+    g_assert_cmpint(llabs(skew_correction(&s, t) - 50000), <, 2000);
+    g_assert_cmpfloat(fabs(skew_drift_ppm(&s)), <, 1.0);
+}
+
+static void test_windows(void)
+{
+    struct skew s;
+
+    skew_init(&s, 1000);
+
+    g_assert(!skew_add(&s, 0, 10));
+    g_assert(!skew_add(&s, 500, 5));
+    g_assert(!skew_valid(&s));
+
+    /* the minimum of the first window is the base */
+    g_assert(skew_add(&s, 1000, 20));
+    g_assert_cmpint(s.base, ==, 5);
+    g_assert(!skew_valid(&s));
+
+    /* a gap starts the next window with the packet */
+    g_assert(skew_add(&s, 5500, 15));
+    g_assert_cmpint(s.window_end, ==, 6500);
+    g_assert(skew_valid(&s));
+}
+
+int main(int argc, char** argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/skew/drift", test_drift);
+    g_test_add_func("/skew/step", test_step);
+    g_test_add_func("/skew/windows", test_windows);
+
+    return g_test_run();
+}
@@ -0,0 +1,71 @@
+/*
+ *  (C) Copyright 2021 Kontron Europe GmbH, Saarbruecken
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <libgen.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "../stats.c"
+
+
+/*
+ * TESTS
+ */
+static void test_stats_shm(void)
+{
+    struct stats_shm *writer;
+    struct stats_shm *reader;
+    struct stats_stream copy;
+    gchar *name;
+
+    name = g_strdup_printf("nl-test-stats-%d", getpid());
+
+    writer = stats_shm_create(name, STATS_ROLE_RX, "test");
+    g_assert(writer != NULL);
+
+    stats_write_begin(&writer->streams[3]);
+    g_assert_cmpint(writer->streams[3].seq & 1, ==, 1);
+    writer->streams[3].active = 1;
+    writer->streams[3].packets = 42;
+    histogram_add(&writer->streams[3].latency, 1000);
+    stats_write_end(&writer->streams[3]);
+    g_assert_cmpint(writer->streams[3].seq & 1, ==, 0);
+
+    reader = stats_shm_open(name);
+    g_assert(reader != NULL);
+    g_assert_cmpint(reader->hdr.role, ==, STATS_ROLE_RX);
+    g_assert_cmpstr(reader->hdr.latency_name, ==, "test");
+
+    g_assert_cmpint(stats_read_stream(reader, 3, &copy), ==, 0);
+    g_assert_cmpint(copy.active, ==, 1);
+    g_assert_cmpint(copy.packets, ==, 42);
+    g_assert_cmpint(copy.latency.count, ==, 1);
+    g_assert_cmpint(copy.latency.min, ==, 1000);
+
+    g_assert_cmpint(stats_read_stream(reader, 0, &copy), ==, 0);
+    g_assert_cmpint(copy.active, ==, 0);
+
+    /* a writer which died during an update does not block the reader */
+    stats_write_begin(&writer->streams[5]);
+    g_assert_cmpint(stats_read_stream(reader, 5, &copy), ==, -1);
+
+    stats_shm_close(reader);
+    stats_shm_destroy(writer, name);
+    g_assert_null(stats_shm_open(name));
+    g_free(name);
+}
+
+int main(int argc, char** argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/stats/shm",
+            test_stats_shm);
+
+    return g_test_run();
+}
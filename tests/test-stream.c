@@ -0,0 +1,116 @@
+/*
+ *  (C) Copyright 2021 Kontron Europe GmbH, Saarbruecken
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <libgen.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "../stream.c"
+
+
+/*
+ * TESTS
+ */
+static void test_publish_drop_oldest(void)
+{
+    struct stream_server server;
+    struct subscriber *sub;
+
+    memset(&server, 0, sizeof(server));
+    server.type = STREAM_UNIX;
+    server.queue_len = 2;
+    server.wake_fd = eventfd(0, EFD_NONBLOCK);
+    pthread_mutex_init(&server.lock, NULL);
+
+    sub = subscriber_add(&server);
+    g_assert(sub != NULL);
+
+    stream_server_publish(&server, "a");
+    stream_server_publish(&server, "b");
+    g_assert_cmpint(sub->len, ==, 2);
+    g_assert_cmpint(sub->dropped, ==, 0);
+
+    stream_server_publish(&server, "c");
+    g_assert_cmpint(sub->len, ==, 2);
+    g_assert_cmpint(sub->dropped, ==, 1);
+
+    /* the drop notice is delivered before the remaining records */
+    g_assert_true(subscriber_next(&server, sub));
+    g_assert_cmpstr(sub->cur, ==,
+            "{\"type\":\"stream-drops\",\"object\":{\"dropped-records\":1}}\n");
+    g_free(sub->cur);
+    sub->cur = NULL;
+
+    g_assert_true(subscriber_next(&server, sub));
+    g_assert_cmpstr(sub->cur, ==, "b\n");
+    g_free(sub->cur);
+    sub->cur = NULL;
+
+    g_assert_true(subscriber_next(&server, sub));
+    g_assert_cmpstr(sub->cur, ==, "c\n");
+    g_free(sub->cur);
+    sub->cur = NULL;
+
+    g_assert_false(subscriber_next(&server, sub));
+
+    subscriber_clear(&server, sub);
+    close(server.wake_fd);
+    pthread_mutex_destroy(&server.lock);
+}
+
+static void test_unix_subscriber(void)
+{
+    struct stream_server *server;
+    struct sockaddr_un addr;
+    gchar *path;
+    char buf[64];
+    ssize_t n;
+    int fd;
+    int i;
+
+    path = g_strdup_printf("/tmp/nl-test-stream-%d", getpid());
+    server = stream_server_new(path, 16);
+    g_assert(server != NULL);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    g_assert_cmpint(connect(fd, (struct sockaddr *)&addr, sizeof(addr)), ==, 0);
+
+    /* wait until the server thread has accepted the subscriber */
+    for (i = 0; i < 1000 && !server->subscribers[0].active; i++) {
+        usleep(1000);
+    }
+    g_assert_true(server->subscribers[0].active);
+
+    stream_server_publish(server, "{\"type\":\"rx-packet\"}");
+
+    n = recv(fd, buf, sizeof(buf) - 1, 0);
+    g_assert_cmpint(n, >, 0);
+    buf[n] = '\0';
+    g_assert_cmpstr(buf, ==, "{\"type\":\"rx-packet\"}\n");
+
+    close(fd);
+    stream_server_free(server);
+    g_assert_cmpint(access(path, F_OK), ==, -1);
+    g_free(path);
+}
+
+int main(int argc, char** argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/stream/publish_drop_oldest",
+            test_publish_drop_oldest);
+
+    g_test_add_func("/stream/unix_subscriber",
+            test_unix_subscriber);
+
+    return g_test_run();
+}
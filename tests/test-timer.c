@@ -321,6 +321,135 @@ void test_get_timer_before_target(void)
 }
 #endif
 
+static void test_timer_wait_until(void)
+{
+	struct timer_waiter w;
+	struct timespec target;
+	struct timespec now;
+	int i;
+
+	for (i = 0; i < TIMER_MAX_STRATEGY; i++) {
+		g_assert_cmpint(timer_strategy_from_name(timer_strategy_name(i)),
+				==, i);
+		g_assert_cmpint(timer_waiter_init(&w, i, CLOCK_MONOTONIC), ==, 0);
+
+		clock_gettime(CLOCK_MONOTONIC, &target);
+		target.tv_nsec += 1000000;
+		if (target.tv_nsec >= NSEC_PER_SEC) {
+			target.tv_nsec -= NSEC_PER_SEC;
+			target.tv_sec++;
+		}
+
+		g_assert_cmpint(timer_wait_until(&w, &target), ==, 0);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		g_assert_cmpint(timespec_diff_ns(&target, &now), >=, 0);
+
+		timer_waiter_close(&w);
+	}
+
+	g_assert_cmpint(timer_strategy_from_name("unknown"), ==, -1);
+}
+
+static void test_timer_schedule(void)
+{
+	struct timer_schedule s;
+	struct timespec interval;
+	struct timespec t0;
+	struct timespec wait;
+	gint64 n;
+
+	interval.tv_sec = 0;
+	interval.tv_nsec = 1000000;
+	g_assert_cmpint(timer_schedule_start(&s, CLOCK_MONOTONIC, &interval, 0),
+			==, 0);
+	g_assert_cmpint(s.t0.tv_nsec % 1000000, ==, 0);
+	t0 = s.t0;
+
+	/* not expired yet */
+	g_assert_cmpint(timer_schedule_expired(&s), ==, 0);
+	g_assert_cmpint(timespec_diff_ns(&t0, &s.t0), ==, 0);
+
+	/* oversleep a few intervals, they are counted as missed */
+	wait.tv_sec = 0;
+	wait.tv_nsec = 5500000;
+	nanosleep(&wait, NULL);
+	n = timer_schedule_expired(&s);
+	g_assert_cmpint(n, >=, 5);
+	g_assert_cmpint(s.missed, ==, n - 1);
+	g_assert_cmpint(timespec_diff_ns(&t0, &s.t0), ==, n * 1000000);
+
+	timer_schedule_stop(&s);
+	g_assert_cmpint(s.tfd, ==, -1);
+
+	/* advancing across a second boundary */
+	s.interval_ns = 250000000;
+	s.t0.tv_sec = 10;
+	s.t0.tv_nsec = 750000000;
+	s.missed = 0;
+	timer_schedule_advance(&s, 3);
+	g_assert_cmpint(s.t0.tv_sec, ==, 11);
+	g_assert_cmpint(s.t0.tv_nsec, ==, 500000000);
+	g_assert_cmpint(s.missed, ==, 2);
+	timer_schedule_advance(&s, 0);
+	g_assert_cmpint(s.missed, ==, 2);
+
+	/* start of earlier intervals */
+	timer_schedule_slot(&s, 3, &t0);
+	g_assert_cmpint(t0.tv_sec, ==, 10);
+	g_assert_cmpint(t0.tv_nsec, ==, 750000000);
+	timer_schedule_slot(&s, 0, &t0);
+	g_assert_cmpint(t0.tv_sec, ==, 11);
+	g_assert_cmpint(t0.tv_nsec, ==, 500000000);
+}
+
+static void test_timer_lead(void)
+{
+	struct timer_lead c;
+	gint64 lead;
+	guint i, w;
+
+	timer_lead_init(&c, 0, 200000, 100);
+	g_assert_cmpint(c.lead_ns, ==, TIMER_SPIN_NS);
+
+	/* a quiet system, the lead shrinks step by step */
+	for (w = 0; w < 30; w++) {
+		lead = c.lead_ns;
+		for (i = 0; i < 99; i++) {
+			g_assert_false(timer_lead_add(&c, 10000));
+		}
+		g_assert_true(timer_lead_add(&c, 10000));
+		g_assert_cmpint(c.lead_ns, <=, lead);
+	}
+	g_assert_cmpint(c.windows, ==, 30);
+	g_assert_true(c.converged);
+	g_assert_cmpint(c.lead_ns, >=, 10000 + TIMER_LEAD_MARGIN_NS);
+	g_assert_cmpint(c.lead_ns, <, 20000);
+	g_assert_cmpint(c.last_late, ==, 0);
+
+	/* a latency spike raises the lead at once, up to the bound */
+	for (i = 0; i < 100; i++) {
+		timer_lead_add(&c, i < 50 ? 10000 : 500000);
+	}
+	g_assert_cmpint(c.lead_ns, ==, 200000);
+	g_assert_cmpint(c.last_late, ==, 50);
+	g_assert_cmpint(c.stable, ==, 0);
+
+	/* a frozen controller keeps its lead */
+	c.frozen = TRUE;
+	for (i = 0; i < 100; i++) {
+		timer_lead_add(&c, 10000);
+	}
+	g_assert_cmpint(c.lead_ns, ==, 200000);
+
+	/* the lower bound */
+	timer_lead_init(&c, 30000, 20000, 10);
+	g_assert_cmpint(c.max_ns, ==, 30000);
+	for (i = 0; i < 10; i++) {
+		timer_lead_add(&c, 0);
+	}
+	g_assert_cmpint(c.lead_ns, ==, 30000);
+}
+
 int main(int argc, char** argv)
 {
 	g_test_init(&argc, &argv, NULL);
@@ -334,6 +463,15 @@ int main(int argc, char** argv)
 	g_test_add_func("/timer/timespec_to_iso_string/valid",
 			test_timespec_to_iso_string);
 
+	g_test_add_func("/timer/wait_until",
+			test_timer_wait_until);
+
+	g_test_add_func("/timer/schedule",
+			test_timer_schedule);
+
+	g_test_add_func("/timer/lead",
+			test_timer_lead);
+
 #if 0
 	g_test_add_func("/timer/a_less_b/false",
 			test_a_less_b);
@@ -0,0 +1,107 @@
+/*
+ *  (C) Copyright 2021 Kontron Europe GmbH, Saarbruecken
+ */
+/* tx.c defines _GNU_SOURCE and has to be included first */
+#define main old_main
+#include "../tx.c"
+#undef main
+
+#include <glib/gstdio.h>
+
+/*
+ * TESTS
+ */
+static void test_flight_recorder(void)
+{
+    struct tx_stats s;
+    struct tx_cycle c;
+    json_t *j;
+    json_t *cycles;
+    guint i;
+
+    tx_stats_init(&s, 4);
+
+    memset(&c, 0, sizeof(c));
+    for (i = 0; i < 6; i++) {
+        c.seq = G_GUINT64_CONSTANT(0x100000000) + i;
+        c.wakeup_ns = 1000 * (i + 1);
+        c.program_ns = 100;
+        c.send_ns = 2000;
+        c.error = i == 5 ? ENOBUFS : 0;
+        tx_stats_add(&s, &c);
+    }
+
+    g_assert_cmpint(s.packets, ==, 6);
+    g_assert_cmpint(s.send_errors, ==, 1);
+    g_assert_cmpint(s.wakeup.count, ==, 6);
+    g_assert_cmpint(s.wakeup.max, ==, 6000);
+
+    /* only the last four cycles are kept, oldest first, with the full
+     * sequence number */
+    j = json_flight_recorder(&s);
+    cycles = json_object_get(json_object_get(j, "object"), "cycles");
+    g_assert_cmpint(json_array_size(cycles), ==, 4);
+    g_assert_cmpint(json_integer_value(json_object_get(
+            json_array_get(cycles, 0), "sequence-number")), ==,
+            G_GUINT64_CONSTANT(0x100000002));
+    g_assert_cmpint(json_integer_value(json_object_get(
+            json_array_get(cycles, 3), "sequence-number")), ==,
+            G_GUINT64_CONSTANT(0x100000005));
+    g_assert_cmpint(json_integer_value(json_object_get(
+            json_array_get(cycles, 3), "error")), ==, ENOBUFS);
+    json_decref(j);
+
+    tx_stats_free(&s);
+}
+
+static void test_json_tx_stats(void)
+{
+    struct tx_stats s;
+    struct tx_cycle c;
+    json_t *j;
+    json_t *o;
+
+    tx_stats_init(&s, 0);
+
+    memset(&c, 0, sizeof(c));
+    c.seq = 7;
+    c.flags = 3 << TP_OVERRUN_SHIFT;
+    c.wakeup_ns = 5000;
+    c.program_ns = 300;
+    c.send_ns = 4000;
+    tx_stats_add(&s, &c);
+    g_assert(s.ring == NULL);
+
+    j = json_tx_stats(&s, 3);
+    g_assert_cmpstr(json_string_value(json_object_get(j, "type")), ==,
+            "tx-stats");
+    o = json_object_get(j, "object");
+    g_assert_cmpint(json_integer_value(json_object_get(o, "packets")), ==, 1);
+    g_assert_cmpint(json_integer_value(
+            json_object_get(o, "missed-intervals")), ==, 3);
+    g_assert_cmpint(json_integer_value(json_object_get(
+            json_object_get(o, "wakeup-ns"), "max")), ==, 5000);
+    g_assert_cmpint(json_integer_value(json_object_get(
+            json_object_get(o, "send-ns"), "min")), ==, 4000);
+    json_decref(j);
+
+    /* an empty flight recorder */
+    tx_stats_init(&s, 2);
+    j = json_flight_recorder(&s);
+    g_assert_cmpint(json_array_size(json_object_get(
+            json_object_get(j, "object"), "cycles")), ==, 0);
+    json_decref(j);
+    tx_stats_free(&s);
+}
+
+int main(int argc, char** argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/tx/flight_recorder",
+            test_flight_recorder);
+    g_test_add_func("/tx/json_tx_stats",
+            test_json_tx_stats);
+
+    return g_test_run();
+}
@@ -1,4 +1,4 @@
-TEST_LIST := timer rx json
+TEST_LIST := timer rx tx json stream histogram stats packet pcapng recorder ftrace skew
 
 TEST_BINARIES = $(addprefix $(o)tests/test-,$(TEST_LIST))
 ALL_TARGETS += $(TEST_BINARIES)
@@ -15,13 +15,44 @@ memleak_report_cmd = G_DEBUG=gc-friendly G_SLICE=always-malloc valgrind \
 $(o)tests/%.o: tests/%.c
 	$(call compile_tgt,tests)
 
-$(o)tests/test-timer: $(o)tests/test-timer.o
+$(o)tests/test-timer: $(o)tests/test-timer.o $(o)histogram.o
 	$(call link_tgt,tests)
 
-$(o)tests/test-rx: $(o)tests/test-rx.o $(o)timer.o $(o)json.o
+$(o)tests/test-rx: $(o)tests/test-rx.o $(o)ftrace.o $(o)timer.o $(o)json.o \
+		$(o)stream.o $(o)histogram.o $(o)packet.o $(o)pcapng.o \
+		$(o)recorder.o $(o)skew.o $(o)stats.o
 	$(call link_tgt,tests)
 
-$(o)tests/test-json: $(o)tests/test-json.o $(o)timer.o
+$(o)tests/test-tx: $(o)tests/test-tx.o $(o)ftrace.o $(o)timer.o \
+		$(o)histogram.o $(o)packet.o $(o)stats.o
+	$(call link_tgt,tests)
+
+$(o)tests/test-json: $(o)tests/test-json.o $(o)timer.o $(o)histogram.o \
+		$(o)skew.o
+	$(call link_tgt,tests)
+
+$(o)tests/test-stream: $(o)tests/test-stream.o
+	$(call link_tgt,tests)
+
+$(o)tests/test-histogram: $(o)tests/test-histogram.o
+	$(call link_tgt,tests)
+
+$(o)tests/test-stats: $(o)tests/test-stats.o $(o)histogram.o
+	$(call link_tgt,tests)
+
+$(o)tests/test-packet: $(o)tests/test-packet.o
+	$(call link_tgt,tests)
+
+$(o)tests/test-pcapng: $(o)tests/test-pcapng.o
+	$(call link_tgt,tests)
+
+$(o)tests/test-recorder: $(o)tests/test-recorder.o
+	$(call link_tgt,tests)
+
+$(o)tests/test-ftrace: $(o)tests/test-ftrace.o
+	$(call link_tgt,tests)
+
+$(o)tests/test-skew: $(o)tests/test-skew.o
 	$(call link_tgt,tests)
 
 test-%: $(o)tests/test-%
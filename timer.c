@@ -32,11 +32,15 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <sys/epoll.h>
 #include <sys/time.h>
 #include <sys/timerfd.h>
 
 #include <glib.h>
 
+#include "histogram.h"
+#include "timer.h"
+
 
 #ifndef TIMEVAL_TO_TIMESPEC
 #define TIMEVAL_TO_TIMESPEC(tv, ts) {          \
@@ -63,6 +67,12 @@ void timespec_diff(const struct timespec *a, const struct timespec *b,
     result->tv_nsec = diff % NSEC_PER_SEC;
 }
 
+/* returns b - a in nanoseconds */
+gint64 timespec_diff_ns(const struct timespec *a, const struct timespec *b)
+{
+    return NSEC_PER_SEC * ((gint64)b->tv_sec - (gint64)a->tv_sec)
+        + ((gint64)b->tv_nsec - (gint64)a->tv_nsec);
+}
 
 #define TIME_BEFORE_NS 300000
 
@@ -84,14 +94,183 @@ static int get_timeval_to_next_slice(struct timespec *now, struct timespec *next
     return 0;
 }
 
-void wait_for_next_timeslice(struct timespec *interval, gint offset_usec,
-        struct timespec *next, struct timespec *t0)
+static const char *strategy_names[TIMER_MAX_STRATEGY] = {
+    [TIMER_NANOSLEEP] = "nanosleep",
+    [TIMER_TIMERFD_READ] = "timerfd-read",
+    [TIMER_TIMERFD_EPOLL] = "timerfd-epoll",
+    [TIMER_SLEEP_SPIN] = "sleep-spin",
+};
+
+const char *timer_strategy_name(int strategy)
+{
+    if (strategy < 0 || strategy >= TIMER_MAX_STRATEGY) {
+        return NULL;
+    }
+
+    return strategy_names[strategy];
+}
+
+int timer_strategy_from_name(const char *name)
+{
+    int i;
+
+    for (i = 0; i < TIMER_MAX_STRATEGY; i++) {
+        if (!g_strcmp0(name, strategy_names[i])) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+int timer_waiter_init(struct timer_waiter *w, int strategy, clockid_t clock)
+{
+    struct epoll_event ev;
+
+    memset(w, 0, sizeof(*w));
+    w->strategy = strategy;
+    w->clock = clock;
+    w->tfd = -1;
+    w->epfd = -1;
+    w->spin_ns = TIMER_SPIN_NS;
+
+    if (strategy != TIMER_TIMERFD_READ && strategy != TIMER_TIMERFD_EPOLL) {
+        return 0;
+    }
+
+    w->tfd = timerfd_create(clock, 0);
+    if (w->tfd < 0) {
+        perror("timerfd_create");
+        return -1;
+    }
+
+    if (strategy == TIMER_TIMERFD_EPOLL) {
+        w->epfd = epoll_create1(0);
+        if (w->epfd < 0) {
+            perror("epoll_create1");
+            timer_waiter_close(w);
+            return -1;
+        }
+
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = w->tfd;
+        if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, w->tfd, &ev)) {
+            perror("epoll_ctl");
+            timer_waiter_close(w);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void timer_waiter_close(struct timer_waiter *w)
+{
+    if (w->epfd >= 0) {
+        close(w->epfd);
+    }
+    if (w->tfd >= 0) {
+        close(w->tfd);
+    }
+    w->epfd = -1;
+    w->tfd = -1;
+}
+
+static int timerfd_wait(struct timer_waiter *w, const struct timespec *target)
 {
+    struct itimerspec its;
+    struct epoll_event ev;
+    guint64 expirations;
     int rc;
+
+    memset(&its, 0, sizeof(its));
+    its.it_value = *target;
+    if (timerfd_settime(w->tfd, TFD_TIMER_ABSTIME, &its, NULL)) {
+        perror("timerfd_settime");
+        return -1;
+    }
+
+    if (w->strategy == TIMER_TIMERFD_EPOLL) {
+        do {
+            rc = epoll_wait(w->epfd, &ev, 1, -1);
+        } while (rc < 0 && errno == EINTR);
+        if (rc < 0) {
+            perror("epoll_wait");
+            return -1;
+        }
+    }
+
+    if (read(w->tfd, &expirations, sizeof(expirations)) < 0) {
+        if (errno != EINTR) {
+            perror("read timerfd");
+        }
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Sleep until shortly before the target and busy wait for the rest, which
+ * trades CPU time for the wakeup latency of the scheduler.
+ */
+static int sleep_spin_wait(struct timer_waiter *w,
+        const struct timespec *target)
+{
+    struct timespec early = *target;
+    struct timespec now;
+    int rc;
+
+    early.tv_nsec -= w->spin_ns;
+    while (early.tv_nsec < 0) {
+        early.tv_nsec += NSEC_PER_SEC;
+        early.tv_sec--;
+    }
+
+    rc = clock_nanosleep(w->clock, TIMER_ABSTIME, &early, NULL);
+    if (rc != 0 && rc != EINTR) {
+        perror("clock_nanosleep failed");
+    }
+
+    do {
+        clock_gettime(w->clock, &now);
+    } while (timespec_diff_ns(&now, target) > 0);
+
+    return 0;
+}
+
+int timer_wait_until(struct timer_waiter *w, const struct timespec *target)
+{
+    int rc;
+
+    switch (w->strategy) {
+    case TIMER_TIMERFD_READ:
+    case TIMER_TIMERFD_EPOLL:
+        return timerfd_wait(w, target);
+    case TIMER_SLEEP_SPIN:
+        return sleep_spin_wait(w, target);
+    case TIMER_NANOSLEEP:
+    default:
+        rc = clock_nanosleep(w->clock, TIMER_ABSTIME, target, NULL);
+        if (rc != 0) {
+            if (rc != EINTR) {
+                perror("clock_nanosleep failed");
+            }
+            return -1;
+        }
+        return 0;
+    }
+}
+
+void wait_for_next_timeslice_with(struct timer_waiter *w,
+        struct timespec *interval, gint offset_usec,
+        struct timespec *next, struct timespec *t0)
+{
     struct timespec ts_now;
     struct timespec ts_target;
 
-    if (clock_gettime(CLOCK_REALTIME, &ts_now)) {
+    if (clock_gettime(w->clock, &ts_now)) {
         perror("clock_gettime");
     }
 
@@ -107,14 +286,210 @@ void wait_for_next_timeslice(struct timespec *interval, gint offset_usec,
         memcpy(next, &ts_target, sizeof(struct timespec));
     }
 
-    rc = clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &ts_target, NULL);
-    if (rc != 0) {
-        if (rc != EINTR) {
-            perror("clock_nanosleep failed");
+    timer_wait_until(w, &ts_target);
+}
+
+void timespec_add_ns(struct timespec *ts, gint64 ns)
+{
+    ns += ts->tv_nsec;
+    ts->tv_sec += ns / NSEC_PER_SEC;
+    ts->tv_nsec = ns % NSEC_PER_SEC;
+    if (ts->tv_nsec < 0) {
+        ts->tv_nsec += NSEC_PER_SEC;
+        ts->tv_sec--;
+    }
+}
+
+/*
+ * Arm a periodic absolute timerfd on the interval grid. The first expiration
+ * is the next slot after now, shifted by the offset. The kernel counts
+ * expirations on its own, hence a late reader still learns how many
+ * intervals have passed.
+ */
+int timer_schedule_start(struct timer_schedule *s, clockid_t clock,
+        struct timespec *interval, gint offset_usec)
+{
+    struct itimerspec its;
+    struct timespec now;
+
+    memset(s, 0, sizeof(*s));
+    s->clock = clock;
+    s->interval_ns = interval->tv_sec * NSEC_PER_SEC + interval->tv_nsec;
+    s->offset_ns = (gint64)offset_usec * 1000;
+
+    s->tfd = timerfd_create(clock, TFD_NONBLOCK);
+    if (s->tfd < 0) {
+        perror("timerfd_create");
+        return -1;
+    }
+
+    clock_gettime(clock, &now);
+    get_timeval_to_next_slice(&now, &s->t0, interval);
+
+    memset(&its, 0, sizeof(its));
+    its.it_value = s->t0;
+    timespec_add_ns(&its.it_value, s->offset_ns);
+    timespec_add_ns(&its.it_interval, s->interval_ns);
+
+    /* t0 is the start of the interval of the last expiration */
+    timespec_add_ns(&s->t0, -s->interval_ns);
+
+    if (timerfd_settime(s->tfd, TFD_TIMER_ABSTIME, &its, NULL)) {
+        perror("timerfd_settime");
+        timer_schedule_stop(s);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Move the expirations to another offset within the interval, starting with
+ * the interval after the current one.
+ */
+int timer_schedule_set_offset(struct timer_schedule *s, gint64 offset_ns)
+{
+    struct itimerspec its;
+
+    s->offset_ns = offset_ns;
+
+    memset(&its, 0, sizeof(its));
+    its.it_value = s->t0;
+    timespec_add_ns(&its.it_value, s->interval_ns + offset_ns);
+    timespec_add_ns(&its.it_interval, s->interval_ns);
+
+    if (timerfd_settime(s->tfd, TFD_TIMER_ABSTIME, &its, NULL)) {
+        perror("timerfd_settime");
+        return -1;
+    }
+
+    return 0;
+}
+
+void timer_schedule_stop(struct timer_schedule *s)
+{
+    if (s->tfd >= 0) {
+        close(s->tfd);
+    }
+    s->tfd = -1;
+}
+
+/* move t0 forward by the number of expirations, all but one were missed */
+void timer_schedule_advance(struct timer_schedule *s, guint64 expirations)
+{
+    if (expirations == 0) {
+        return;
+    }
+
+    timespec_add_ns(&s->t0, (gint64)expirations * s->interval_ns);
+    s->missed += expirations - 1;
+}
+
+/* start of the interval which was n intervals before the current one */
+void timer_schedule_slot(struct timer_schedule *s, guint64 n,
+        struct timespec *t0)
+{
+    *t0 = s->t0;
+    timespec_add_ns(t0, -(gint64)n * s->interval_ns);
+}
+
+/*
+ * Consume the expirations of the timerfd. Returns the number of expirations
+ * since the last call, 0 if the timer has not expired yet and -1 on error.
+ */
+gint64 timer_schedule_expired(struct timer_schedule *s)
+{
+    guint64 expirations;
+
+    if (read(s->tfd, &expirations, sizeof(expirations)) < 0) {
+        if (errno == EAGAIN || errno == EINTR) {
+            return 0;
         }
+        perror("read timerfd");
+        return -1;
     }
 
-    return;
+    timer_schedule_advance(s, expirations);
+
+    return expirations;
+}
+
+void timer_lead_init(struct timer_lead *c, gint64 min_ns, gint64 max_ns,
+        guint window)
+{
+    memset(c, 0, sizeof(*c));
+    c->min_ns = min_ns;
+    c->max_ns = MAX(max_ns, min_ns);
+    c->lead_ns = CLAMP(TIMER_SPIN_NS, c->min_ns, c->max_ns);
+    c->window = MAX(window, 1);
+    histogram_init(&c->latency);
+}
+
+/*
+ * Add the wakeup latency of one interval. At the end of a window the lead
+ * is set to the TIMER_LEAD_PERCENTILE of the latency plus a margin, within
+ * the bounds. The lead grows at once but shrinks slowly, so a single quiet
+ * window does not cause late wakeups. It has converged after
+ * TIMER_LEAD_STABLE windows without a significant change. Returns TRUE at
+ * the end of a window.
+ */
+gboolean timer_lead_add(struct timer_lead *c, gint64 latency_ns)
+{
+    gint64 wanted;
+    gint64 lead;
+
+    histogram_add(&c->latency, latency_ns);
+    c->late += latency_ns > c->lead_ns;
+
+    if (c->latency.count < c->window) {
+        return FALSE;
+    }
+
+    c->windows++;
+    c->last_p50 = histogram_percentile(&c->latency, 50.0);
+    c->last_pct = histogram_percentile(&c->latency, TIMER_LEAD_PERCENTILE);
+    c->last_max = c->latency.max;
+    c->last_late = c->late;
+
+    if (!c->frozen) {
+        wanted = c->last_pct + TIMER_LEAD_MARGIN_NS;
+        if (wanted > c->lead_ns) {
+            lead = wanted;
+        } else {
+            lead = c->lead_ns - (c->lead_ns - wanted) / 4;
+        }
+        lead = CLAMP(lead, c->min_ns, c->max_ns);
+
+        if (ABS(lead - c->lead_ns) <= MAX(TIMER_LEAD_MARGIN_NS,
+                    c->lead_ns / 20)) {
+            c->stable++;
+        } else {
+            c->stable = 0;
+        }
+        c->lead_ns = lead;
+
+        if (c->stable >= TIMER_LEAD_STABLE) {
+            c->converged = TRUE;
+        }
+    }
+
+    histogram_init(&c->latency);
+    c->late = 0;
+
+    return TRUE;
+}
+
+void wait_for_next_timeslice(struct timespec *interval, gint offset_usec,
+        struct timespec *next, struct timespec *t0)
+{
+    struct timer_waiter w = {
+        .strategy = TIMER_NANOSLEEP,
+        .clock = CLOCK_REALTIME,
+        .tfd = -1,
+        .epfd = -1,
+    };
+
+    wait_for_next_timeslice_with(&w, interval, offset_usec, next, t0);
 }
 
 char *timespec_to_iso_string(struct timespec *time)
@@ -27,12 +27,114 @@
 #ifndef __TIMER_H__
 #define __TIMER_H__
 
+#include "histogram.h"
+
 void timespec_diff(const struct timespec *a, const struct timespec *b,
         struct timespec *result);
 
 void wait_for_next_timeslice(struct timespec *interval, gint offset_usec,
         struct timespec *next, struct timespec *t0);
 
+/* strategies to wait for an absolute time */
+enum {
+    TIMER_NANOSLEEP = 0,
+    TIMER_TIMERFD_READ,
+    TIMER_TIMERFD_EPOLL,
+    TIMER_SLEEP_SPIN,
+
+    TIMER_MAX_STRATEGY
+};
+
+/* sleep-spin wakes up this early and busy waits for the target */
+#define TIMER_SPIN_NS 50000
+
+struct timer_waiter {
+    int strategy;
+    clockid_t clock;
+    int tfd;
+    int epfd;
+    gint64 spin_ns;
+};
+
+const char *timer_strategy_name(int strategy);
+
+int timer_strategy_from_name(const char *name);
+
+int timer_waiter_init(struct timer_waiter *w, int strategy, clockid_t clock);
+
+void timer_waiter_close(struct timer_waiter *w);
+
+int timer_wait_until(struct timer_waiter *w, const struct timespec *target);
+
+void wait_for_next_timeslice_with(struct timer_waiter *w,
+        struct timespec *interval, gint offset_usec,
+        struct timespec *next, struct timespec *t0);
+
+/* periodic schedule on an absolute timerfd */
+struct timer_schedule {
+    int tfd;
+    clockid_t clock;
+    gint64 interval_ns;
+    gint64 offset_ns;
+
+    /* start of the interval of the last expiration */
+    struct timespec t0;
+
+    /* expirations which were not consumed in time */
+    guint64 missed;
+};
+
+int timer_schedule_start(struct timer_schedule *s, clockid_t clock,
+        struct timespec *interval, gint offset_usec);
+
+int timer_schedule_set_offset(struct timer_schedule *s, gint64 offset_ns);
+
+void timer_schedule_stop(struct timer_schedule *s);
+
+void timer_schedule_advance(struct timer_schedule *s, guint64 expirations);
+
+gint64 timer_schedule_expired(struct timer_schedule *s);
+
+void timer_schedule_slot(struct timer_schedule *s, guint64 n,
+        struct timespec *t0);
+
+/*
+ * Closed loop control of the lead time, i.e. how early the thread wakes up
+ * before the target time, from the observed wakeup latency.
+ */
+#define TIMER_LEAD_PERCENTILE 99.9
+#define TIMER_LEAD_MARGIN_NS 2000
+#define TIMER_LEAD_STABLE 3
+
+struct timer_lead {
+    gint64 lead_ns;
+    gint64 min_ns;
+    gint64 max_ns;
+    guint window;
+    struct histogram latency;
+    guint64 late;
+
+    /* result of the last window */
+    guint windows;
+    gint64 last_p50;
+    gint64 last_pct;
+    gint64 last_max;
+    guint64 last_late;
+
+    guint stable;
+    gboolean converged;
+    gboolean frozen;
+};
+
+void timer_lead_init(struct timer_lead *c, gint64 min_ns, gint64 max_ns,
+        guint window);
+
+gboolean timer_lead_add(struct timer_lead *c, gint64 latency_ns);
+
+gint64 timespec_diff_ns(const struct timespec *a, const struct timespec *b);
+
+void timespec_add_ns(struct timespec *ts, gint64 ns);
+
 char *timespec_to_iso_string(struct timespec *time);
 
 #endif /* __TIMER_H__ */
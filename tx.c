@@ -35,12 +35,16 @@
 #include <netinet/in.h>
 #include <netpacket/packet.h>
 #include <linux/net_tstamp.h>
+#include <poll.h>
 #include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/signalfd.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -54,6 +58,10 @@
 #include <jansson.h>
 
 #include "data.h"
+#include "ftrace.h"
+#include "packet.h"
+#include "probes.h"
+#include "stats.h"
 #include "timer.h"
 
 #ifndef VERSION
@@ -64,20 +72,65 @@ static gchar *help_description = NULL;
 static gchar *o_destination_mac = "FF:FF:FF:FF:FF:FF";
 static gint o_count = 0;
 static gint o_cpu_number = -1;
-static gint o_interval_ms = 1000;
+static gint o_interval_ms = -1;
+static gint o_interval_usec = 0;
 static gint o_interval_offset_usec = 0;
 static gint o_padding = -1;
 static gint o_sched_prio = 99;
 static gint o_stream_id = 0;
 static gint o_etf = 0;
 static gint o_etf_offset_usec = 0;
+static gint o_follow_up = 0;
 static gint o_verbose = 0;
 static gint o_version = 0;
 static gint o_small_pkt_mode = 0;
 static int o_queue_prio = -1;
+static gchar *o_shm_name = NULL;
+static gint o_timer_bench = FALSE;
+static gchar *o_timer_clock = "realtime";
+static gchar *o_overrun = "skip";
+static gint o_overrun_late_max = 16;
+static gint o_flight_recorder = 1000;
+static gint o_lead_auto = FALSE;
+static gint o_lead_min_usec = 0;
+static gint o_lead_max_usec = -1;
+static gint o_lead_freeze = FALSE;
+static gint o_packet_version = TP_VERSION_1;
+static gint o_trace_marker = FALSE;
+static gint o_breaktrace_usec = 0;
+static gint o_rtt = FALSE;
+static gint o_no_hw_ts = FALSE;
+
+/* handling of intervals which have passed while the TX thread was late */
+enum {
+    OVERRUN_SKIP = 0,
+    OVERRUN_LATE,
+    OVERRUN_MARKER,
+
+    MAX_OVERRUN_POLICY
+};
+
+static const char *overrun_policy_names[MAX_OVERRUN_POLICY] = {
+    [OVERRUN_SKIP] = "skip",
+    [OVERRUN_LATE] = "late",
+    [OVERRUN_MARKER] = "marker",
+};
+
+static int overrun_policy = OVERRUN_SKIP;
 
-static char tp_buf[1518];
-struct ether_testpacket *tp = (void*)tp_buf;
+static struct stats_shm *stats_shm = NULL;
+static struct ftrace *ftrace = NULL;
+static gboolean hw_tx_timestamps = FALSE;
+
+/* receive side of --rtt, stopped by main once the TX thread has finished */
+static int rtt_fd = -1;
+static gboolean rtt_stop = FALSE;
+
+/* the test packet in host representation and its frame on the wire */
+#define TX_FRAME_SIZE 1518
+static struct ether_testpacket tp_host;
+struct ether_testpacket *tp = &tp_host;
+static char tp_frame[TX_FRAME_SIZE];
 
 static int get_sk_interface_index(int fd, const char *name)
 {
@@ -139,6 +192,33 @@ static int setsockopt_priority(int fd, int prio)
     return rc;
 }
 
+/*
+ * Switch on hardware TX timestamping of the interface. The RX filter is
+ * kept as nl-rx may use the same interface. Fails if the driver does not
+ * support hardware timestamps.
+ */
+static int set_hwtimestamping(int fd, const char *ifname)
+{
+    struct ifreq ifr;
+    struct hwtstamp_config config;
+
+    memset(&ifr, 0, sizeof(ifr));
+    memset(&config, 0, sizeof(config));
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", ifname);
+    ifr.ifr_data = (caddr_t)&config;
+
+    if (ioctl(fd, SIOCGHWTSTAMP, &ifr)) {
+        config.rx_filter = HWTSTAMP_FILTER_NONE;
+    }
+    config.flags = 0;
+    config.tx_type = HWTSTAMP_TX_ON;
+    if (ioctl(fd, SIOCSHWTSTAMP, &ifr)) {
+        return -1;
+    }
+
+    return 0;
+}
+
 static int setsockopt_timestamping(int fd)
 {
     int rc, opt;
@@ -148,6 +228,13 @@ static int setsockopt_timestamping(int fd)
           | SOF_TIMESTAMPING_TX_SCHED
 #endif
           | SOF_TIMESTAMPING_SOFTWARE;
+    if (hw_tx_timestamps) {
+        opt |= SOF_TIMESTAMPING_TX_HARDWARE
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 13, 0)
+              | SOF_TIMESTAMPING_OPT_TX_SWHW
+#endif
+              | SOF_TIMESTAMPING_RAW_HARDWARE;
+    }
 
     rc = setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &opt, sizeof(opt));
     if (rc == -1) {
@@ -199,6 +286,9 @@ static GOptionEntry entries[] = {
     { "interval",    'i', 0, G_OPTION_ARG_INT,
             &o_interval_ms,
             "Interval in milli seconds (default is 1000)", "INTERVAL" },
+    { "interval-usec", 'u', 0, G_OPTION_ARG_INT,
+            &o_interval_usec,
+            "Interval in micro seconds, overrides --interval", "USEC" },
     { "stream-id",   'I', 0, G_OPTION_ARG_INT,
             &o_stream_id,
             "Set stream id (default is 0)", "ID" },
@@ -209,6 +299,9 @@ static GOptionEntry entries[] = {
             &o_etf_offset_usec,
             "The ETF offset in usec", "ETF-OFFSET"},
 
+    { "follow-up",   'F', 0, G_OPTION_ARG_NONE,
+            &o_follow_up,
+            "Send kernel TX timestamps in separate follow-up frames", NULL },
     { "count",       'c', 0, G_OPTION_ARG_INT,
             &o_count,
             "Transmit packet count", "COUNT" },
@@ -227,6 +320,61 @@ static GOptionEntry entries[] = {
     { "queue-prio",  'Q', 0, G_OPTION_ARG_INT,
             &o_queue_prio,
             "Set skb priority", "PRIO" },
+    { "timer-bench", 0, 0, G_OPTION_ARG_NONE,
+            &o_timer_bench,
+            "Measure the wakeup latency of each timer strategy without"
+            " sending", NULL },
+    { "timer-clock", 0, 0, G_OPTION_ARG_STRING,
+            &o_timer_clock,
+            "Clock of the timer benchmark: realtime, monotonic or tai"
+            " (default is realtime)", "CLOCK" },
+    { "overrun",     0, 0, G_OPTION_ARG_STRING,
+            &o_overrun,
+            "Handling of missed intervals: skip, late or marker"
+            " (default is skip)", "POLICY" },
+    { "overrun-late-max", 0, 0, G_OPTION_ARG_INT,
+            &o_overrun_late_max,
+            "Maximum number of late packets sent for one overrun, the older"
+            " missed intervals are skipped (default is 16)", "NUM" },
+    { "lead-auto",   0, 0, G_OPTION_ARG_NONE,
+            &o_lead_auto,
+            "Adapt how early the thread wakes up to send at the offset",
+            NULL },
+    { "lead-min",    0, 0, G_OPTION_ARG_INT,
+            &o_lead_min_usec,
+            "Lower bound of the lead time in usec (default is 0)", "USEC" },
+    { "lead-max",    0, 0, G_OPTION_ARG_INT,
+            &o_lead_max_usec,
+            "Upper bound of the lead time in usec (default is half the"
+            " interval)", "USEC" },
+    { "lead-freeze", 0, 0, G_OPTION_ARG_NONE,
+            &o_lead_freeze,
+            "Keep the lead time once it has converged", NULL },
+    { "flight-recorder", 'R', 0, G_OPTION_ARG_INT,
+            &o_flight_recorder,
+            "Keep the timing of the last N intervals, dumped on SIGUSR1 and"
+            " at exit (default is 1000)", "N" },
+    { "shm",         'm', 0, G_OPTION_ARG_STRING,
+            &o_shm_name,
+            "Publish live statistics in shared memory segment NAME", "NAME" },
+    { "trace-marker", 0, 0, G_OPTION_ARG_NONE,
+            &o_trace_marker,
+            "Annotate the wakeup and the send of each interval in the ftrace"
+            " buffer", NULL },
+    { "breaktrace",  0, 0, G_OPTION_ARG_INT,
+            &o_breaktrace_usec,
+            "Stop ftrace once the wakeup latency exceeds USEC", "USEC" },
+    { "rtt",         0, 0, G_OPTION_ARG_NONE,
+            &o_rtt,
+            "Receive the test packets sent back by nl-rx --reflect and"
+            " report the round trip time", NULL },
+    { "packet-version", 'W', 0, G_OPTION_ARG_INT,
+            &o_packet_version,
+            "Wire format of the test packets, 1 or 2 (default is 1)",
+            "VERSION" },
+    { "no-hw-ts",    'n', 0, G_OPTION_ARG_NONE,
+            &o_no_hw_ts,
+            "Do not request hardware TX timestamps", NULL },
     { "small-pkt-mode", 'S', 0, G_OPTION_ARG_NONE,
             &o_small_pkt_mode,
             "Send small packets (<64 bytes), only include important timestamps", NULL },
@@ -327,46 +475,113 @@ static void tp_set_timestamp(struct ether_testpacket *tp, int tsnum, struct
     }
 }
 
-static void get_tx_timestamps(int fd, struct timespec *ts1,
-        struct timespec *ts2)
+/* default number of wakeups per strategy of the timer benchmark */
+#define TIMER_BENCH_LOOPS 10000
+
+/* upper bound for waiting on the TX timestamps of a follow-up */
+#define FOLLOW_UP_WAIT_MS 10
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 17, 0)
+#define TX_TIMESTAMPS_PER_PACKET 2
+#else
+#define TX_TIMESTAMPS_PER_PACKET 1
+#endif
+
+/* the driver reports the software and the hardware timestamp separately */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 13, 0)
+#define TX_TIMESTAMPS_HW_EXTRA 1
+#else
+#define TX_TIMESTAMPS_HW_EXTRA 0
+#endif
+
+static gboolean timespec_is_zero(const struct timespec *ts)
+{
+    return ts->tv_sec == 0 && ts->tv_nsec == 0;
+}
+
+/* number of error queue messages to expect for each test packet */
+static int tx_timestamps_per_packet(void)
+{
+    return TX_TIMESTAMPS_PER_PACKET
+            + (hw_tx_timestamps ? TX_TIMESTAMPS_HW_EXTRA : 0);
+}
+
+/*
+ * Collect the kernel TX timestamps which are in the error queue. The
+ * timestamps of one packet arrive in separate messages, num counts the ones
+ * seen for the current packet. The timestamps are cleared for each packet.
+ *
+ * Unfortunately the kernel doesn't tell us the type of a software
+ * timestamp. There is no sock_extended_err CMSG for a AF_PACKET socket.
+ * Might be a bug in the kernel. Therefore, we assume that the first software
+ * timestamp we receive is the one of the network scheduler and the second
+ * one the one of the driver. Hardware timestamps come in the third slot.
+ */
+static void collect_tx_timestamps(int fd, int *num, struct timespec *ts_sched,
+        struct timespec *ts_sw, struct timespec *ts_hw)
 {
     struct msghdr msg;
     char control[256];
     char buf[512];
     struct iovec iov = { buf, sizeof(buf) };
     struct cmsghdr *cm;
-    struct timespec *_ts;
+    struct timespec *ts;
 
-    memset(ts1, 0, sizeof(*ts1));
-    memset(ts2, 0, sizeof(*ts2));
+    for (;;) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
 
-    memset(control, 0, sizeof(control));
-    memset(&msg, 0, sizeof(msg));
-
-    msg.msg_iov = &iov;
-    msg.msg_iovlen = 1;
-    msg.msg_control = control;
-    msg.msg_controllen = sizeof(control);
+        if (recvmsg(fd, &msg, MSG_DONTWAIT | MSG_ERRQUEUE) <= 0) {
+            break;
+        }
 
-    /*
-     * Unfortunately the kernel doesn't tell us the type of the timestamp.
-     * There is no sock_extended_err CMSG for a AF_PACKET socket. Might be a
-     * bug in the kernel. Therefore, we assume that the first timestamp we
-     * receive is the one of the network scheduler and the second one the one
-     * of the driver.
-     */
-    ssize_t len = 0;
-    while ((len = recvmsg(fd, &msg, MSG_DONTWAIT | MSG_ERRQUEUE)) > 0) {
         for (cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
-            if (cm->cmsg_level == SOL_SOCKET
-                    && cm->cmsg_type == SO_TIMESTAMPING
-                    && cm->cmsg_len >= sizeof(struct timespec) * 3) {
-                _ts = (struct timespec *)CMSG_DATA(cm);
+            if (cm->cmsg_level != SOL_SOCKET
+                    || cm->cmsg_type != SO_TIMESTAMPING
+                    || cm->cmsg_len < CMSG_LEN(sizeof(struct timespec) * 3)) {
+                continue;
+            }
+            ts = (struct timespec *)CMSG_DATA(cm);
+            if (!timespec_is_zero(&ts[2])) {
+                *ts_hw = ts[2];
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 17, 0)
-                *ts1 = *ts2;
+            } else if (timespec_is_zero(ts_sched)) {
+                *ts_sched = ts[0];
 #endif
-                *ts2 = *_ts;
+            } else {
+                *ts_sw = ts[0];
             }
+            (*num)++;
+        }
+    }
+}
+
+/*
+ * Wait until the kernel TX timestamps of the last transmitted packet are in
+ * the error queue or the timeout has elapsed, num counts the ones already
+ * collected. Only used once the stream has ended, the TX loop collects the
+ * timestamps from its error queue event.
+ */
+static void wait_tx_timestamps(int fd, int *num, struct timespec *ts_sched,
+        struct timespec *ts_sw, struct timespec *ts_hw, gint timeout_ms)
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLERR };
+    gint64 deadline = g_get_monotonic_time() + timeout_ms * 1000;
+
+    while (*num < tx_timestamps_per_packet()) {
+        gint64 remaining = deadline - g_get_monotonic_time();
+        int last = *num;
+
+        if (remaining <= 0 || poll(&pfd, 1, remaining / 1000 + 1) <= 0) {
+            break;
+        }
+
+        collect_tx_timestamps(fd, num, ts_sched, ts_sw, ts_hw);
+        if (*num == last) {
+            break;
         }
     }
 }
@@ -379,19 +594,148 @@ guint64 gettime_ns(void)
     return ts.tv_sec * (1000ULL * 1000 * 1000) + ts.tv_nsec;
 }
 
-static void *timer_thread(void *params)
+/*
+ * Send a frame without TX timestamping to keep the error queue reserved for
+ * the test packets. With ETF the frame needs a transmit time like the test
+ * packets, the qdisc drops it otherwise.
+ */
+static void send_untimestamped(int fd, void *buf, size_t len)
+{
+    char control[CMSG_SPACE(sizeof(guint32)) + CMSG_SPACE(sizeof(guint64))];
+    struct msghdr msg = {0};
+    struct iovec iov = {0};
+    struct cmsghdr *cm;
+    guint32 tsflags = 0;
+
+    iov.iov_base = buf;
+    iov.iov_len = len;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    memset(control, 0, sizeof(control));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SO_TIMESTAMPING;
+    cm->cmsg_len = CMSG_LEN(sizeof(tsflags));
+    memcpy(CMSG_DATA(cm), &tsflags, sizeof(tsflags));
+
+    if (o_etf) {
+        guint64 transmit_time = gettime_ns() + o_etf_offset_usec * 1000;
+
+        cm = CMSG_NXTHDR(&msg, cm);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_TXTIME;
+        cm->cmsg_len = CMSG_LEN(sizeof(transmit_time));
+        memcpy(CMSG_DATA(cm), &transmit_time, sizeof(transmit_time));
+    } else {
+        msg.msg_controllen = CMSG_SPACE(sizeof(tsflags));
+    }
+
+    if (sendmsg(fd, &msg, 0) == -1) {
+        perror("error sendmsg untimestamped");
+    }
+}
+
+/* convert a packet to its wire format, padded to the requested size */
+static gsize tp_to_frame(struct ether_testpacket *p, guint num_timestamps,
+        char *frame)
+{
+    gssize len = tp_encode(p, num_timestamps, frame, TX_FRAME_SIZE);
+
+    return CLAMP(MAX(len, o_padding), 0, TX_FRAME_SIZE);
+}
+
+/* header of a frame which refers to the current test packet */
+static void tp_copy_header(struct ether_testpacket *dst,
+        struct ether_testpacket *src)
+{
+    memcpy(&dst->hdr, &src->hdr, sizeof(dst->hdr));
+    dst->version = src->version;
+    dst->stream_id = src->stream_id;
+    dst->seq = src->seq;
+    dst->interval_usec = src->interval_usec;
+    dst->offset_usec = src->offset_usec;
+}
+
+/*
+ * The follow-up frame carries the kernel TX timestamps of the test packet
+ * with the same sequence number.
+ */
+static void send_follow_up(int fd, struct ether_testpacket *tp,
+        struct timespec *ts_sched, struct timespec *ts_sw,
+        struct timespec *ts_hw)
+{
+    static struct ether_testpacket fu_host;
+    static char fu_frame[TX_FRAME_SIZE];
+    struct ether_testpacket *fu = &fu_host;
+
+    memset(fu, 0, sizeof(*fu));
+    tp_copy_header(fu, tp);
+    fu->flags = TP_FLAG_FOLLOW_UP | (tp->flags & TP_FLAG_END_OF_STREAM);
+
+    tp_set_timestamp(fu, TS_LAST_KERNEL_SCHED, ts_sched);
+    tp_set_timestamp(fu, TS_LAST_KERNEL_SW_TX, ts_sw);
+    tp_set_timestamp(fu, TS_LAST_KERNEL_HW_TX, ts_hw);
+
+    send_untimestamped(fd, fu_frame, tp_to_frame(fu, TS_MAX_NUM, fu_frame));
+}
+
+/*
+ * The marker reports missed intervals as soon as the TX thread notices
+ * them. It has the sequence number of the first missed interval, its start
+ * and the wakeup time.
+ */
+static void send_overrun_marker(int fd, struct ether_testpacket *tp,
+        struct timespec *t0, guint32 missed)
+{
+    static struct ether_testpacket marker_host;
+    static char marker_frame[TX_FRAME_SIZE];
+    struct ether_testpacket *marker = &marker_host;
+
+    memset(marker, 0, sizeof(*marker));
+    tp_copy_header(marker, tp);
+    marker->flags = TP_FLAG_OVERRUN_MARKER | (missed << TP_OVERRUN_SHIFT);
+
+    tp_set_timestamp(marker, TS_T0, t0);
+    tp_set_timestamp(marker, TS_WAKEUP, NULL);
+
+    send_untimestamped(fd, marker_frame, tp_to_frame(marker, 2, marker_frame));
+}
+
+/*
+ * Publish the sender counters in the shared memory segment. The latency is
+ * the wakeup latency of the timer thread.
+ */
+static void update_shm_stats(struct stats_stream *s,
+        struct ether_testpacket *tp, gboolean send_failed)
+{
+    struct timespec ts_t0;
+    struct timespec ts_wakeup;
+    gint64 latency;
+
+    /* copy the timestamps to avoid unaligned pointer compiler errors */
+    memcpy(&ts_t0, &tp->timestamps[TS_T0], sizeof(ts_t0));
+    memcpy(&ts_wakeup, &tp->timestamps[TS_WAKEUP], sizeof(ts_wakeup));
+    latency = timespec_diff_ns(&ts_t0, &ts_wakeup);
+
+    stats_write_begin(s);
+    s->active = 1;
+    s->packets++;
+    s->dropped += send_failed;
+    s->latency_last = latency;
+    histogram_add(&s->latency, latency);
+    stats_write_end(s);
+}
+
+/* pin the calling thread to the selected CPU and make it real-time */
+static void setup_rt_thread(const char *name)
 {
-    struct thread_param *parm = params;
     struct sched_param schedp;
-    struct timespec next;
-    struct timespec interval_start;
-    struct timespec interval;
-    struct timespec last_sched_tx_ts;
-    struct timespec last_sw_tx_ts;
-    gint64 count = 0;
-    int size;
 
-    pthread_setname_np(pthread_self(), "TX RT thread");
+    pthread_setname_np(pthread_self(), name);
 
     if (o_cpu_number != -1) {
         cpu_set_t cpuset;
@@ -421,91 +765,1018 @@ static void *timer_thread(void *params)
     if (sched_setscheduler(0, SCHED_FIFO, &schedp)) {
         perror("failed to set scheduler policy");
     }
+}
 
-    interval.tv_sec = 0;
-    interval.tv_nsec = o_interval_ms * 1000000;
+/* sender timing of one interval, kept in the flight recorder */
+struct tx_cycle {
+    guint64 seq;
+    guint32 flags;
+    struct timespec t0;
+    gint64 wakeup_ns;
+    gint64 program_ns;
+    gint64 send_ns;
+    int error;
+};
+
+/*
+ * In-process view of the sender timing: histograms of the wakeup latency
+ * (tx-wakeup - interval-start), the program latency (tx-program -
+ * tx-wakeup) and the duration of the send call, and a ring of the last
+ * intervals.
+ */
+struct tx_stats {
+    guint64 packets;
+    guint64 send_errors;
+    struct histogram wakeup;
+    struct histogram program;
+    struct histogram send;
+
+    struct tx_cycle *ring;
+    guint ring_size;
+    guint64 ring_head;
+};
+
+static void tx_stats_init(struct tx_stats *s, guint ring_size)
+{
+    memset(s, 0, sizeof(*s));
+    histogram_init(&s->wakeup);
+    histogram_init(&s->program);
+    histogram_init(&s->send);
+
+    /* allocated up front, the TX thread runs with locked memory */
+    s->ring_size = ring_size;
+    if (ring_size) {
+        s->ring = g_new0(struct tx_cycle, ring_size);
+    }
+}
+
+static void tx_stats_free(struct tx_stats *s)
+{
+    g_free(s->ring);
+    s->ring = NULL;
+}
 
-    tp->interval_usec = o_interval_ms * 1000;
+static void tx_stats_add(struct tx_stats *s, struct tx_cycle *c)
+{
+    s->packets++;
+    s->send_errors += c->error != 0;
+    histogram_add(&s->wakeup, c->wakeup_ns);
+    histogram_add(&s->program, c->program_ns);
+    histogram_add(&s->send, c->send_ns);
+
+    if (s->ring_size) {
+        s->ring[s->ring_head++ % s->ring_size] = *c;
+    }
+}
+
+static json_t *json_latency(struct histogram *h)
+{
+    json_t *buckets = json_array();
+    guint i;
+
+    for (i = 0; i < HIST_NUM_BUCKETS; i++) {
+        if (h->buckets[i]) {
+            json_array_append_new(buckets, json_pack("[III]",
+                    (json_int_t)histogram_bucket_lower(i),
+                    (json_int_t)histogram_bucket_upper(i),
+                    (json_int_t)h->buckets[i]));
+        }
+    }
+
+    return json_pack("{sIsIsIsIsIsIsIso}",
+            "min", (json_int_t)(h->count ? h->min : 0),
+            "mean", (json_int_t)(h->count ? h->sum / (gint64)h->count : 0),
+            "p50", (json_int_t)histogram_percentile(h, 50.0),
+            "p99", (json_int_t)histogram_percentile(h, 99.0),
+            "p99.9", (json_int_t)histogram_percentile(h, 99.9),
+            "max", (json_int_t)(h->count ? h->max : 0),
+            "early", (json_int_t)h->underflow,
+            "histogram", buckets);
+}
+
+static json_t *json_tx_stats(struct tx_stats *s, guint64 missed)
+{
+    return json_pack("{sss{sisIsIsIsososo}}",
+            "type", "tx-stats",
+            "object",
+            "stream-id", o_stream_id,
+            "packets", (json_int_t)s->packets,
+            "missed-intervals", (json_int_t)missed,
+            "send-errors", (json_int_t)s->send_errors,
+            "wakeup-ns", json_latency(&s->wakeup),
+            "program-ns", json_latency(&s->program),
+            "send-ns", json_latency(&s->send));
+}
+
+/* the cycles of the flight recorder, oldest first */
+static json_t *json_flight_recorder(struct tx_stats *s)
+{
+    json_t *cycles = json_array();
+    guint64 i;
+
+    i = s->ring_head > s->ring_size ? s->ring_head - s->ring_size : 0;
+    for (; i < s->ring_head; i++) {
+        struct tx_cycle *c = &s->ring[i % s->ring_size];
+        char *t0 = timespec_to_iso_string(&c->t0);
+
+        json_array_append_new(cycles, json_pack("{sIsssIsIsIsisisi}",
+                "sequence-number", (json_int_t)c->seq,
+                "interval-start", t0,
+                "wakeup-ns", (json_int_t)c->wakeup_ns,
+                "program-ns", (json_int_t)c->program_ns,
+                "send-ns", (json_int_t)c->send_ns,
+                "missed-intervals", TP_OVERRUNS(c->flags),
+                "flags", c->flags & ((1 << TP_OVERRUN_SHIFT) - 1),
+                "error", c->error));
+        g_free(t0);
+    }
+
+    return json_pack("{sss{siso}}",
+            "type", "tx-flight-recorder",
+            "object",
+            "stream-id", o_stream_id,
+            "cycles", cycles);
+}
+
+static void print_json(json_t *j)
+{
+    char *s = json_dumps(j, JSON_COMPACT);
+
+    printf("%s\n", s);
+    fflush(stdout);
+    free(s);
+    json_decref(j);
+}
+
+static void dump_tx_stats(struct tx_stats *s, guint64 missed)
+{
+    print_json(json_tx_stats(s, missed));
+    if (s->ring_size) {
+        print_json(json_flight_recorder(s));
+    }
+}
+
+static json_t *json_tx_breaktrace(struct tx_cycle *c, gint64 threshold_ns)
+{
+    return json_pack("{sss{sisIsssIsI}}",
+            "type", "tx-breaktrace",
+            "object",
+            "stream-id", o_stream_id,
+            "sequence-number", (json_int_t)c->seq,
+            "stage", "wakeup",
+            "value-ns", (json_int_t)c->wakeup_ns,
+            "threshold-ns", (json_int_t)threshold_ns);
+}
+
+/*
+ * Annotate the send of an interval in the ftrace buffer and stop tracing
+ * if the wakeup latency exceeds the --breaktrace bound.
+ */
+static void trace_sent(guint64 cycle_num, struct tx_cycle *c)
+{
+    gint64 threshold_ns = (gint64)o_breaktrace_usec * 1000;
+
+    if (o_trace_marker) {
+        ftrace_mark(ftrace, "nl-tx cycle=%" G_GUINT64_FORMAT " seq=%"
+                G_GUINT64_FORMAT " stage=sent wakeup-ns=%" G_GINT64_FORMAT,
+                cycle_num, c->seq, c->wakeup_ns);
+    }
+
+    if (threshold_ns && c->wakeup_ns > threshold_ns
+            && ftrace_break(ftrace, "nl-tx breaktrace seq=%"
+                G_GUINT64_FORMAT " wakeup-ns=%" G_GINT64_FORMAT
+                " threshold-ns=%" G_GINT64_FORMAT, c->seq, c->wakeup_ns, threshold_ns)) {
+        print_json(json_tx_breaktrace(c, threshold_ns));
+    }
+}
+
+static json_t *json_tx_lead(struct timer_lead *c)
+{
+    return json_pack("{sss{sisisIsIsIsIsIsbsb}}",
+            "type", "tx-lead",
+            "object",
+            "stream-id", o_stream_id,
+            "window", c->windows,
+            "lead-ns", (json_int_t)c->lead_ns,
+            "latency-p50", (json_int_t)c->last_p50,
+            "latency-p99.9", (json_int_t)c->last_pct,
+            "latency-max", (json_int_t)c->last_max,
+            "late", (json_int_t)c->last_late,
+            "converged", c->converged,
+            "frozen", c->frozen);
+}
+
+/* event sources of the TX loop */
+enum {
+    TX_EVENT_TIMER = 0,
+    TX_EVENT_ERRQUEUE,
+    TX_EVENT_CONTROL,
+
+    TX_MAX_EVENT
+};
+
+struct tx_loop {
+    int fd;
+    int epfd;
+    int sfd;
+    struct timer_schedule sched;
+
+    /* kernel TX timestamps of the last transmitted packet */
+    struct timespec last_sched_tx_ts;
+    struct timespec last_sw_tx_ts;
+    struct timespec last_hw_tx_ts;
+    int num_tx_ts;
+
+    /* test packet whose follow-up waits for the TX timestamps */
+    struct ether_testpacket fu_tp;
+    gboolean fu_pending;
+
+    gint64 count;
+    int stop;
+
+    struct tx_stats stats;
+    struct timer_lead lead;
+};
+
+/* signals handled by the control fd of the TX loop */
+static void tx_signal_mask(sigset_t *mask)
+{
+    sigemptyset(mask);
+    sigaddset(mask, SIGINT);
+    sigaddset(mask, SIGTERM);
+    sigaddset(mask, SIGUSR1);
+}
+
+static int tx_loop_add(struct tx_loop *l, int fd, guint32 events, int source)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.u32 = source;
+    if (epoll_ctl(l->epfd, EPOLL_CTL_ADD, fd, &ev)) {
+        perror("epoll_ctl");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Set up the event sources: the schedule as absolute timerfd, the error
+ * queue of the socket and a signalfd for SIGINT, SIGTERM and SIGUSR1, which are blocked by
+ * main().
+ */
+static int tx_loop_init(struct tx_loop *l, int fd)
+{
+    struct timespec interval;
+    sigset_t mask;
+
+    memset(l, 0, sizeof(*l));
+    l->fd = fd;
+    l->sfd = -1;
+    l->sched.tfd = -1;
+    tx_stats_init(&l->stats, MAX(o_flight_recorder, 0));
+
+    l->epfd = epoll_create1(0);
+    if (l->epfd < 0) {
+        perror("epoll_create1");
+        return -1;
+    }
+
+    /* if interval is 0 send as fast as possible */
+    if (o_interval_usec != 0) {
+        interval.tv_sec = 0;
+        interval.tv_nsec = (glong)o_interval_usec * 1000;
+        if (timer_schedule_start(&l->sched, CLOCK_REALTIME, &interval,
+                    o_interval_offset_usec)) {
+            return -1;
+        }
+        if (tx_loop_add(l, l->sched.tfd, EPOLLIN, TX_EVENT_TIMER)) {
+            return -1;
+        }
+    }
+
+    /* one window covers about a second */
+    if (o_lead_auto) {
+        timer_lead_init(&l->lead, (gint64)o_lead_min_usec * 1000,
+                (gint64)o_lead_max_usec * 1000,
+                CLAMP(1000000 / o_interval_usec, 10, 1000));
+        if (timer_schedule_set_offset(&l->sched,
+                    (gint64)o_interval_offset_usec * 1000 - l->lead.lead_ns)) {
+            return -1;
+        }
+    }
+
+    if (tx_loop_add(l, fd, EPOLLERR, TX_EVENT_ERRQUEUE)) {
+        return -1;
+    }
+
+    tx_signal_mask(&mask);
+    l->sfd = signalfd(-1, &mask, SFD_NONBLOCK);
+    if (l->sfd < 0) {
+        perror("signalfd");
+    } else if (tx_loop_add(l, l->sfd, EPOLLIN, TX_EVENT_CONTROL)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static void tx_loop_close(struct tx_loop *l)
+{
+    tx_stats_free(&l->stats);
+    timer_schedule_stop(&l->sched);
+    if (l->sfd >= 0) {
+        close(l->sfd);
+    }
+    if (l->epfd >= 0) {
+        close(l->epfd);
+    }
+}
+
+/*
+ * The first SIGINT or SIGTERM ends the stream with the next packet, so the
+ * receiver sees a regular end of stream. Another one stops immediately.
+ * SIGUSR1 dumps the statistics and the flight recorder.
+ */
+static void handle_control(struct tx_loop *l)
+{
+    struct signalfd_siginfo si;
+
+    while (read(l->sfd, &si, sizeof(si)) == sizeof(si)) {
+        if (si.ssi_signo == SIGUSR1) {
+            dump_tx_stats(&l->stats, l->sched.missed);
+        } else {
+            l->stop++;
+        }
+    }
+}
+
+/* send the follow-up of the last test packet with the timestamps collected */
+static void flush_follow_up(struct tx_loop *l)
+{
+    send_follow_up(l->fd, &l->fu_tp, &l->last_sched_tx_ts, &l->last_sw_tx_ts,
+            &l->last_hw_tx_ts);
+    l->fu_pending = FALSE;
+}
+
+static ssize_t send_test_packet(struct tx_loop *l, struct timespec *t0,
+        guint32 flags, gboolean last)
+{
+    struct timespec ts_wakeup;
+    struct timespec ts_prog;
+    struct timespec ts_send;
+    struct timespec ts_sent;
+    struct tx_cycle cycle;
+    guint64 cycle_num = l->stats.packets;
+    ssize_t ret;
+    guint num_timestamps;
+    gsize size;
+
+    /* update timestamps in packet */
+    clock_gettime(CLOCK_REALTIME, &ts_wakeup);
+    NL_PROBE4(tx_wakeup, tp->stream_id, tp->seq, NL_PROBE_NS(*t0),
+            NL_PROBE_NS(ts_wakeup));
+    tp_set_timestamp(tp, TS_WAKEUP, &ts_wakeup);
+
+    /* the marker is accounted to the program latency */
+    if (o_trace_marker) {
+        ftrace_mark(ftrace, "nl-tx cycle=%" G_GUINT64_FORMAT " seq=%"
+                G_GUINT64_FORMAT " stage=wakeup", cycle_num, tp->seq);
+    }
+
+    tp_set_timestamp(tp, TS_T0, t0);
+
+    if (!o_small_pkt_mode) {
+        tp_set_timestamp(tp, TS_LAST_KERNEL_SCHED, &l->last_sched_tx_ts);
+        tp_set_timestamp(tp, TS_LAST_KERNEL_SW_TX, &l->last_sw_tx_ts);
+        clock_gettime(CLOCK_REALTIME, &ts_prog);
+        tp_set_timestamp(tp, TS_PROG_SEND, &ts_prog);
+        tp->flags = 0;
+        num_timestamps = 5;
+    } else {
+        tp->flags = TP_FLAG_SMALL_MODE;
+        num_timestamps = 1;
+    }
+
+    tp->flags |= flags;
+    if (last) {
+        tp->flags |= TP_FLAG_END_OF_STREAM;
+    }
+
+    size = tp_to_frame(tp, num_timestamps, tp_frame);
+
+    clock_gettime(CLOCK_REALTIME, &ts_send);
+    if (o_small_pkt_mode) {
+        ts_prog = ts_send;
+    }
+    NL_PROBE4(tx_patch, tp->stream_id, tp->seq, NL_PROBE_NS(ts_prog), size);
+
+    if (o_etf) {
+        struct msghdr msg = {0};
+        struct iovec iov = {0};
+        char control[CMSG_SPACE(sizeof(guint64))];
+        struct cmsghdr *cm;
+        guint64 transmit_time;
+
+        iov.iov_base = tp_frame;
+        iov.iov_len = size;
+
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+
+        memset(control, 0, sizeof(control));
+        msg.msg_control = &control;
+        msg.msg_controllen = sizeof(control);
+
+        transmit_time = gettime_ns();
+        transmit_time += o_etf_offset_usec * 1000;
+
+        cm = CMSG_FIRSTHDR(&msg);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_TXTIME;
+        cm->cmsg_len = CMSG_LEN(sizeof(transmit_time));
+        memcpy(CMSG_DATA(cm), &transmit_time, sizeof(transmit_time));
+
+        ret = sendmsg(l->fd, &msg, 0);
+        if (ret == -1)
+            perror("error sendmsg");
+        if (ret == 0)
+            perror("error sendmsg");
+
+    } else {
+        ret = send(l->fd, tp_frame, size, 0);
+    }
+    cycle.error = ret <= 0 ? errno : 0;
+    clock_gettime(CLOCK_REALTIME, &ts_sent);
+    NL_PROBE5(tx_send, tp->stream_id, tp->seq, ret, NL_PROBE_NS(ts_send),
+            NL_PROBE_NS(ts_sent));
+
+    if (stats_shm) {
+        update_shm_stats(&stats_shm->streams[o_stream_id], tp, ret <= 0);
+    }
+
+    cycle.seq = tp->seq;
+    cycle.flags = tp->flags;
+    cycle.t0 = *t0;
+    cycle.wakeup_ns = timespec_diff_ns(t0, &ts_wakeup);
+    cycle.program_ns = timespec_diff_ns(&ts_wakeup, &ts_prog);
+    cycle.send_ns = timespec_diff_ns(&ts_send, &ts_sent);
+    tx_stats_add(&l->stats, &cycle);
+
+    if (ftrace) {
+        trace_sent(cycle_num, &cycle);
+    }
+
+    /* timestamps missing after a whole interval will not come anymore */
+    if (l->fu_pending) {
+        flush_follow_up(l);
+    }
+
+    /* the next packet carries the timestamps of this one only */
+    memset(&l->last_sched_tx_ts, 0, sizeof(l->last_sched_tx_ts));
+    memset(&l->last_sw_tx_ts, 0, sizeof(l->last_sw_tx_ts));
+    memset(&l->last_hw_tx_ts, 0, sizeof(l->last_hw_tx_ts));
+    l->num_tx_ts = 0;
+
+    /* the follow-up is sent from the error queue event, the TX thread does
+     * not wait for the timestamps */
+    if (o_follow_up) {
+        l->fu_tp = *tp;
+        l->fu_pending = TRUE;
+    }
+
+    tp->seq++;
+
+    return ret;
+}
+
+/*
+ * Send the test packet of an interval, unless the stream has ended. Returns
+ * TRUE for the last packet of the stream.
+ */
+static gboolean send_interval(struct tx_loop *l, struct timespec *t0,
+        guint32 flags)
+{
+    gboolean last = l->stop || (o_count && ++l->count >= o_count);
+
+    send_test_packet(l, t0, flags, last);
+
+    return last;
+}
+
+/*
+ * The TX thread woke up after more than one interval has passed. Every
+ * missed interval consumes its sequence number, so the receiver can tell
+ * the gap apart from lost packets by the count in the next packet. With the
+ * late policy the packets of the last --overrun-late-max missed intervals
+ * are sent right away instead, older ones are skipped. Returns TRUE if the
+ * stream has ended.
+ */
+static gboolean handle_overrun(struct tx_loop *l, guint64 missed,
+        guint32 *flags)
+{
+    struct timespec t0;
+    guint64 late = 0;
+    guint64 skipped;
+    guint64 i;
+
+    if (missed == 0) {
+        return FALSE;
+    }
+
+    if (overrun_policy == OVERRUN_LATE) {
+        late = MIN(missed, (guint64)o_overrun_late_max);
+    }
+    skipped = missed - late;
+
+    if (skipped) {
+        *flags = MIN(skipped, TP_OVERRUN_MAX) << TP_OVERRUN_SHIFT;
+
+        if (overrun_policy == OVERRUN_MARKER) {
+            timer_schedule_slot(&l->sched, missed, &t0);
+            send_overrun_marker(l->fd, tp, &t0,
+                    MIN(skipped, TP_OVERRUN_MAX));
+        }
+
+        tp->seq += skipped;
+    }
+
+    /* the first late packet carries the count of the skipped intervals */
+    for (i = late; i > 0; i--) {
+        timer_schedule_slot(&l->sched, i, &t0);
+        if (send_interval(l, &t0, *flags | TP_FLAG_LATE)) {
+            return TRUE;
+        }
+        *flags = 0;
+    }
+
+    return FALSE;
+}
+
+/*
+ * With --lead-auto the timer expires the lead time before the target, the
+ * interval start plus the offset. Busy wait for the target, so the packet
+ * is sent at the same phase, and feed the wakeup latency to the
+ * controller. A new lead time moves the timer from the next interval on.
+ */
+static void lead_wait(struct tx_loop *l)
+{
+    struct timespec target;
+    struct timespec wakeup;
+    struct timespec now;
+    gint64 lead_ns = l->lead.lead_ns;
+    gint64 latency;
+
+    target = l->sched.t0;
+    timespec_add_ns(&target, (gint64)o_interval_offset_usec * 1000);
+    wakeup = target;
+    timespec_add_ns(&wakeup, -lead_ns);
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    latency = timespec_diff_ns(&wakeup, &now);
+    while (timespec_diff_ns(&now, &target) > 0) {
+        clock_gettime(CLOCK_REALTIME, &now);
+    }
+
+    if (!timer_lead_add(&l->lead, latency)) {
+        return;
+    }
+
+    if (o_lead_freeze && l->lead.converged) {
+        l->lead.frozen = TRUE;
+    }
+
+    if (l->lead.lead_ns != lead_ns) {
+        timer_schedule_set_offset(&l->sched,
+                (gint64)o_interval_offset_usec * 1000 - l->lead.lead_ns);
+    }
+
+    print_json(json_tx_lead(&l->lead));
+}
+
+/*
+ * A single epoll loop waits for the schedule, the TX timestamps in the
+ * error queue and the control fd and handles each as soon as it is ready.
+ */
+static void *timer_thread(void *params)
+{
+    struct thread_param *parm = params;
+    struct epoll_event events[TX_MAX_EVENT];
+    struct tx_loop l;
+    gboolean last = FALSE;
+
+    setup_rt_thread("TX RT thread");
+
+    tp->interval_usec = o_interval_usec;
     tp->offset_usec = o_interval_offset_usec;
     tp->stream_id = o_stream_id;
-    tp->version = 1;
+    tp->version = o_packet_version;
 
-    while (TRUE) {
-        /* get timestamp of last transmitted packet */
-        get_tx_timestamps(parm->fd, &last_sched_tx_ts, &last_sw_tx_ts);
+    if (tx_loop_init(&l, parm->fd)) {
+        tx_loop_close(&l);
+        return NULL;
+    }
 
-        /* if interval is 0 send as fast as possible */
-        if (o_interval_ms != 0) {
-            wait_for_next_timeslice(&interval, o_interval_offset_usec,
-                    &next, &interval_start);
+    while (!last && l.stop < 2) {
+        struct timespec t0;
+        gint64 expirations = 0;
+        guint32 flags = 0;
+        int n, i;
+
+        n = epoll_wait(l.epfd, events, TX_MAX_EVENT,
+                o_interval_usec ? -1 : 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            break;
         }
 
-        /* update timestamps in packet */
-        tp_set_timestamp(tp, TS_WAKEUP, NULL);
+        for (i = 0; i < n; i++) {
+            switch (events[i].data.u32) {
+            case TX_EVENT_TIMER:
+                expirations = timer_schedule_expired(&l.sched);
+                break;
+            case TX_EVENT_ERRQUEUE:
+                collect_tx_timestamps(l.fd, &l.num_tx_ts,
+                        &l.last_sched_tx_ts, &l.last_sw_tx_ts,
+                        &l.last_hw_tx_ts);
+                /* the timestamps belong to the last packet sent */
+                NL_PROBE6(tx_errqueue, tp->stream_id, tp->seq - 1,
+                        l.num_tx_ts, NL_PROBE_NS(l.last_sched_tx_ts),
+                        NL_PROBE_NS(l.last_sw_tx_ts),
+                        NL_PROBE_NS(l.last_hw_tx_ts));
+                if (l.fu_pending
+                        && l.num_tx_ts >= tx_timestamps_per_packet()) {
+                    flush_follow_up(&l);
+                }
+                break;
+            case TX_EVENT_CONTROL:
+                handle_control(&l);
+                break;
+            }
+        }
 
-        tp_set_timestamp(tp, TS_T0, &interval_start);
+        if (o_interval_usec == 0) {
+            clock_gettime(CLOCK_REALTIME, &t0);
+            expirations = 1;
+        }
 
-        if (!o_small_pkt_mode) {
-            tp_set_timestamp(tp, TS_LAST_KERNEL_SCHED, &last_sched_tx_ts);
-            tp_set_timestamp(tp, TS_LAST_KERNEL_SW_TX, &last_sw_tx_ts);
-            tp_set_timestamp(tp, TS_PROG_SEND, NULL);
-            tp->flags = 0;
-            size = TP_LEN(5);
-        } else {
-            tp->flags = TP_FLAG_SMALL_MODE;
-            size = TP_LEN(1);
+        if (expirations <= 0 || l.stop > 1) {
+            continue;
+        }
+
+        if (o_lead_auto) {
+            lead_wait(&l);
         }
 
-        if (o_count && ++count >= o_count) {
-            tp->flags = TP_FLAG_END_OF_STREAM;
+        last = handle_overrun(&l, expirations - 1, &flags);
+        if (!last) {
+            if (o_interval_usec != 0) {
+                t0 = l.sched.t0;
+            }
+            last = send_interval(&l, &t0, flags);
         }
+    }
+
+    /* the stream has ended, the follow-up of the last packet may wait */
+    if (l.fu_pending) {
+        wait_tx_timestamps(l.fd, &l.num_tx_ts, &l.last_sched_tx_ts,
+                &l.last_sw_tx_ts, &l.last_hw_tx_ts, FOLLOW_UP_WAIT_MS);
+        flush_follow_up(&l);
+    }
 
-        if (o_etf) {
-            struct msghdr msg = {0};
-            struct iovec iov = {0};
-            char control[CMSG_SPACE(sizeof(guint64))];
-            struct cmsghdr *cm;
-            guint64 transmit_time;
-            int ret;
+    if (l.sched.missed) {
+        fprintf(stderr, "%" G_GUINT64_FORMAT " intervals missed\n",
+                l.sched.missed);
+    }
 
-            iov.iov_base = (char*)tp;
-            iov.iov_len = MAX(size, o_padding);
+    dump_tx_stats(&l.stats, l.sched.missed);
 
-            msg.msg_iov = &iov;
-            msg.msg_iovlen = 1;
+    tx_loop_close(&l);
 
-            memset(control, 0, sizeof(control));
-            msg.msg_control = &control;
-            msg.msg_controllen = sizeof(control);
+    return NULL;
+}
 
-            transmit_time = gettime_ns();
-            transmit_time += o_etf_offset_usec * 1000;
+/* poll interval of the RTT receiver for the stop request */
+#define RTT_POLL_MS 100
 
-            cm = CMSG_FIRSTHDR(&msg);
-            cm->cmsg_level = SOL_SOCKET;
-            cm->cmsg_type = SCM_TXTIME;
-            cm->cmsg_len = CMSG_LEN(sizeof(transmit_time));
-            memcpy(CMSG_DATA(cm), &transmit_time, sizeof(transmit_time));
+/* time the RTT receiver waits for reflections after the last packet */
+#define RTT_LINGER_MS 1000
 
-            ret = sendmsg(parm->fd, &msg, 0);
-            if (ret == -1)
-                perror("error sendmsg");
-            if (ret == 0)
-                perror("error sendmsg");
+struct rtt_stats {
+    guint64 packets;
+    guint64 lost;
+    gboolean have_seq;
+    guint64 last_seq;
+    struct histogram rtt;
+    struct histogram residence;
+    struct histogram net;
+};
 
-        } else {
-            send(parm->fd, (char*)tp, MAX(size, o_padding), 0);
+static int rtt_open(const char *name)
+{
+    struct sockaddr_ll sll;
+    struct timeval tv = { 0, RTT_POLL_MS * 1000 };
+    int opt;
+    int fd;
+
+    fd = socket(PF_PACKET, SOCK_RAW, htons(TP_ETHER_TYPE));
+    if (fd < 0) {
+        perror("socket() ... rtt");
+        return -1;
+    }
+
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(TP_ETHER_TYPE);
+    sll.sll_ifindex = get_sk_interface_index(fd, name);
+    if (bind(fd, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+        perror("bind() ... rtt");
+        close(fd);
+        return -1;
+    }
+
+    /* software timestamps, the send time is taken from CLOCK_REALTIME */
+    opt = SOF_TIMESTAMPING_RX_SOFTWARE
+          | SOF_TIMESTAMPING_SOFTWARE;
+    if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &opt, sizeof(opt))
+            || setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv))) {
+        perror("setsockopt() ... rtt");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/*
+ * Receive the next reflection of our stream. rx_ts is the kernel software
+ * receive timestamp or, without one, the program receive time. Both are
+ * CLOCK_REALTIME like the send time in the packet.
+ */
+static gboolean rtt_receive(int fd, struct ether_testpacket *rp,
+        struct timespec *rx_ts)
+{
+    char buf[TX_FRAME_SIZE];
+    char control[256];
+    struct iovec iov = { buf, sizeof(buf) };
+    struct msghdr msg;
+    struct cmsghdr *cm;
+    ssize_t len;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    len = recvmsg(fd, &msg, 0);
+    if (len <= 0) {
+        return FALSE;
+    }
+    clock_gettime(CLOCK_REALTIME, rx_ts);
+
+    if (tp_decode(buf, len, rp) || !(rp->flags & TP_FLAG_REFLECTED)
+            || rp->stream_id != o_stream_id) {
+        return FALSE;
+    }
+
+    for (cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (cm->cmsg_level == SOL_SOCKET
+                && cm->cmsg_type == SO_TIMESTAMPING) {
+            struct timespec *ts = (struct timespec *)CMSG_DATA(cm);
+
+            if (ts[0].tv_sec || ts[0].tv_nsec) {
+                *rx_ts = ts[0];
+            }
         }
-        tp->seq++;
+    }
+
+    return TRUE;
+}
 
-        if (tp->flags == TP_FLAG_END_OF_STREAM) {
+static json_t *json_tx_rtt(struct ether_testpacket *rp, gint64 rtt_ns,
+        gint64 residence_ns)
+{
+    return json_pack("{sss{sisIsIsIsI}}",
+            "type", "tx-rtt",
+            "object",
+            "stream-id", rp->stream_id,
+            "sequence-number", (json_int_t)rp->seq,
+            "rtt-ns", (json_int_t)rtt_ns,
+            "residence-ns", (json_int_t)residence_ns,
+            "net-rtt-ns", (json_int_t)(rtt_ns - residence_ns));
+}
+
+static json_t *json_tx_rtt_stats(struct rtt_stats *s)
+{
+    return json_pack("{sss{sisIsIsososo}}",
+            "type", "tx-rtt-stats",
+            "object",
+            "stream-id", o_stream_id,
+            "packets", (json_int_t)s->packets,
+            "lost", (json_int_t)s->lost,
+            "rtt-ns", json_latency(&s->rtt),
+            "residence-ns", json_latency(&s->residence),
+            "net-rtt-ns", json_latency(&s->net));
+}
+
+/*
+ * The round trip time is measured from the program send time of the test
+ * packet, the interval start in small packet mode, to its reception here.
+ * The residence time is the time the frame spent in the reflector, by the
+ * clock of the reflector; the net round trip time excludes it.
+ */
+static void rtt_add(struct rtt_stats *s, struct ether_testpacket *rp,
+        struct timespec *rx_ts)
+{
+    int tx_slot = (rp->flags & TP_FLAG_SMALL_MODE) ? TS_T0 : TS_PROG_SEND;
+    gint64 rtt_ns;
+    gint64 residence_ns;
+
+    rtt_ns = timespec_diff_ns(&rp->timestamps[tx_slot], rx_ts);
+    residence_ns = timespec_diff_ns(&rp->timestamps[TS_REFLECT_RX],
+            &rp->timestamps[TS_REFLECT_TX]);
+
+    /* intervals the sender has missed are no loss */
+    if (s->have_seq && rp->seq > s->last_seq + 1) {
+        guint64 gap = rp->seq - s->last_seq - 1;
+        s->lost += gap - MIN(gap, TP_OVERRUNS(rp->flags));
+    }
+    if (!s->have_seq || rp->seq > s->last_seq) {
+        s->last_seq = rp->seq;
+        s->have_seq = TRUE;
+    }
+
+    s->packets++;
+    histogram_add(&s->rtt, rtt_ns);
+    histogram_add(&s->residence, residence_ns);
+    histogram_add(&s->net, rtt_ns - residence_ns);
+
+    NL_PROBE4(tx_rtt, rp->stream_id, rp->seq, rtt_ns, residence_ns);
+    print_json(json_tx_rtt(rp, rtt_ns, residence_ns));
+}
+
+/*
+ * Receive the reflections until the end of the stream comes back or for
+ * RTT_LINGER_MS after the TX thread has finished. Not a realtime thread,
+ * the timestamps are taken by the kernel.
+ */
+static void *rtt_thread(void *params)
+{
+    struct rtt_stats s;
+    struct ether_testpacket rp;
+    struct timespec rx_ts;
+    gint64 linger_end = 0;
+
+    (void)params;
+
+    pthread_setname_np(pthread_self(), "RTT thread");
+
+    memset(&s, 0, sizeof(s));
+    histogram_init(&s.rtt);
+    histogram_init(&s.residence);
+    histogram_init(&s.net);
+
+    for (;;) {
+        if (rtt_stop && linger_end == 0) {
+            linger_end = g_get_monotonic_time() + RTT_LINGER_MS * 1000;
+        }
+        if (linger_end && g_get_monotonic_time() >= linger_end) {
+            break;
+        }
+
+        if (!rtt_receive(rtt_fd, &rp, &rx_ts)) {
+            continue;
+        }
+        rtt_add(&s, &rp, &rx_ts);
+        if (rp.flags & TP_FLAG_END_OF_STREAM) {
             break;
         }
     }
 
+    print_json(json_tx_rtt_stats(&s));
+
     return NULL;
 }
 
+static clockid_t parse_clock(const gchar *name)
+{
+    if (!g_strcmp0(name, "realtime")) {
+        return CLOCK_REALTIME;
+    } else if (!g_strcmp0(name, "monotonic")) {
+        return CLOCK_MONOTONIC;
+    } else if (!g_strcmp0(name, "tai")) {
+        return CLOCK_TAI;
+    }
+
+    return -1;
+}
+
+static json_t *json_timer_bench(int strategy, struct histogram *h,
+        int cpu, int migrations, guint64 loops)
+{
+    return json_pack("{sss{sssssisisisIso}}",
+            "type", "tx-timer-bench",
+            "object",
+            "strategy", timer_strategy_name(strategy),
+            "clock", o_timer_clock,
+            "cpu", cpu,
+            "cpu-migrations", migrations,
+            "interval-usec", o_interval_usec,
+            "loops", (json_int_t)loops,
+            "latency-ns", json_latency(h));
+}
+
+/*
+ * Run the wakeup path of the timer thread with each strategy and measure the
+ * latency from the target time to the wakeup, like cyclictest does.
+ */
+static void *timer_bench_thread(void *params)
+{
+    clockid_t clock = parse_clock(o_timer_clock);
+    guint64 loops = o_count ? o_count : TIMER_BENCH_LOOPS;
+    struct timespec interval;
+    int strategy;
+
+    (void)params;
+
+    setup_rt_thread("TX timer bench");
+
+    interval.tv_sec = 0;
+    interval.tv_nsec = (glong)o_interval_usec * 1000;
+
+    for (strategy = 0; strategy < TIMER_MAX_STRATEGY; strategy++) {
+        struct timer_waiter w;
+        struct histogram h;
+        int cpu = -1;
+        int migrations = 0;
+        guint64 i;
+
+        if (timer_waiter_init(&w, strategy, clock)) {
+            continue;
+        }
+        histogram_init(&h);
+
+        for (i = 0; i < loops; i++) {
+            struct timespec next;
+            struct timespec now;
+
+            wait_for_next_timeslice_with(&w, &interval,
+                    o_interval_offset_usec, &next, NULL);
+            clock_gettime(clock, &now);
+
+            histogram_add(&h, timespec_diff_ns(&next, &now));
+
+            if (sched_getcpu() != cpu) {
+                migrations += (cpu != -1);
+                cpu = sched_getcpu();
+            }
+        }
+
+        timer_waiter_close(&w);
+
+        print_json(json_timer_bench(strategy, &h, cpu, migrations, loops));
+    }
+
+    return NULL;
+}
+
+static int run_timer_bench(void)
+{
+    pthread_t thread;
+
+    if (parse_clock(o_timer_clock) == (clockid_t)-1) {
+        fprintf(stderr, "unknown clock %s\n", o_timer_clock);
+        return -1;
+    }
+
+    if (o_interval_usec == 0) {
+        fprintf(stderr, "the timer benchmark needs an interval\n");
+        return -1;
+    }
+
+    /* use the /dev/cpu_dma_latency trick if it's there */
+    set_latency_target(latency_target_value);
+
+    if (mlockall(MCL_CURRENT|MCL_FUTURE) == -1) {
+        perror("mlockal");
+        return -1;
+    }
+
+    if (pthread_create(&thread, NULL, timer_bench_thread, NULL)) {
+        perror("pthread_create");
+        return -1;
+    }
+    pthread_join(thread, NULL);
+
+    return 0;
+}
+
 static void show_version(void)
 {
     g_printf("%s\n", VERSION);
@@ -517,7 +1788,9 @@ int main(int argc, char **argv)
     int fd;
     struct ifreq ifopts;
     pthread_t thread;
+    pthread_t rtt_thread_id;
     pthread_attr_t attr;
+    sigset_t sigmask;
 
     parse_command_line_options(&argc, argv);
 
@@ -526,11 +1799,67 @@ int main(int argc, char **argv)
         return 0;
     }
 
-    if (argc < 2) {
+    if (argc < 2 && !o_timer_bench) {
         usage();
         return -1;
     }
 
+    /* the timer benchmark defaults to a shorter interval */
+    if (o_interval_usec == 0 && o_interval_ms < 0) {
+        o_interval_ms = o_timer_bench ? 1 : 1000;
+    }
+    if (o_interval_usec == 0) {
+        o_interval_usec = o_interval_ms * 1000;
+    }
+    if (o_interval_usec < 0 || o_interval_usec > 1000000) {
+        fprintf(stderr, "interval must not exceed one second\n");
+        return -1;
+    }
+    if (ABS((gint64)o_interval_offset_usec) >= MAX(o_interval_usec, 1)) {
+        fprintf(stderr, "interval offset must be smaller than the interval\n");
+        return -1;
+    }
+
+    if (o_timer_bench) {
+        return run_timer_bench();
+    }
+
+    if (tp_wire_len(o_packet_version, 0) == 0) {
+        fprintf(stderr, "unknown packet version %d\n", o_packet_version);
+        return -1;
+    }
+
+    if (o_lead_auto) {
+        if (o_interval_usec == 0) {
+            fprintf(stderr, "--lead-auto needs an interval\n");
+            return -1;
+        }
+        if (o_lead_max_usec < 0) {
+            o_lead_max_usec = o_interval_usec / 2;
+        }
+        if (o_lead_min_usec < 0 || o_lead_min_usec > o_lead_max_usec
+                || o_lead_max_usec >= o_interval_usec) {
+            fprintf(stderr, "lead time bounds must be within the interval\n");
+            return -1;
+        }
+    }
+
+    for (overrun_policy = 0; overrun_policy < MAX_OVERRUN_POLICY;
+            overrun_policy++) {
+        if (!g_strcmp0(o_overrun, overrun_policy_names[overrun_policy])) {
+            break;
+        }
+    }
+    if (overrun_policy == MAX_OVERRUN_POLICY) {
+        fprintf(stderr, "unknown overrun policy %s\n", o_overrun);
+        return -1;
+    }
+    if (o_overrun_late_max < 0) {
+        fprintf(stderr, "invalid overrun late maximum %d\n",
+                o_overrun_late_max);
+        return -1;
+    }
+
     fd = eth_open(argv[1]);
     if (fd < 0) {
         perror("eth_open");
@@ -541,12 +1870,27 @@ int main(int argc, char **argv)
         setsockopt_priority(fd, o_queue_prio);
     }
 
+    if (!o_no_hw_ts) {
+        if (set_hwtimestamping(fd, argv[1]) == 0) {
+            hw_tx_timestamps = TRUE;
+        } else {
+            fprintf(stderr, "%s: no hardware TX timestamps, using software"
+                    " timestamps only\n", argv[1]);
+        }
+    }
     setsockopt_timestamping(fd);
 
     if (o_etf) {
         setsockopt_txtime(fd);
     }
 
+    if (o_rtt) {
+        rtt_fd = rtt_open(argv[1]);
+        if (rtt_fd < 0) {
+            return -1;
+        }
+    }
+
     /* use the /dev/cpu_dma_latency trick if it's there */
     set_latency_target(latency_target_value);
 
@@ -591,9 +1935,48 @@ int main(int argc, char **argv)
     }
     thread_param.fd = fd;
 
+    if (o_shm_name) {
+        if (o_stream_id < 0 || o_stream_id >= STATS_MAX_STREAMS) {
+            fprintf(stderr, "stream id out of range for --shm\n");
+            return -1;
+        }
+        stats_shm = stats_shm_create(o_shm_name, STATS_ROLE_TX,
+                "tx-wakeup - interval-start");
+        if (stats_shm == NULL) {
+            return -1;
+        }
+    }
+
+    if (o_trace_marker || o_breaktrace_usec) {
+        ftrace = ftrace_open(NULL);
+        if (ftrace == NULL) {
+            return -1;
+        }
+    }
+
+    /* signals are handled by the signalfd of the TX loop */
+    tx_signal_mask(&sigmask);
+    pthread_sigmask(SIG_BLOCK, &sigmask, NULL);
+
+    if (o_rtt && pthread_create(&rtt_thread_id, NULL, rtt_thread, NULL)) {
+        perror("pthread_create ... rtt");
+        return -1;
+    }
+
     rv = pthread_create(&thread, &attr, timer_thread, &thread_param);
 
     pthread_join(thread, NULL);
 
+    if (o_rtt) {
+        rtt_stop = TRUE;
+        pthread_join(rtt_thread_id, NULL);
+        close(rtt_fd);
+    }
+
+    ftrace_close(ftrace);
+    if (stats_shm) {
+        stats_shm_destroy(stats_shm, o_shm_name);
+    }
+
     return rv;
 }